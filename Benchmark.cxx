@@ -0,0 +1,205 @@
+// Times solve() on generated positions and prints the latency distribution and the mean number of
+// states expanded as CSV, one row per rack size bucket and number of jokers, followed by a row for
+// all positions.
+//
+//   g++ -std=c++20 -O2 -c Position*.cxx Search.cxx Simulator.cxx TileSet.cxx ThreadPool.cxx
+//   g++ -std=c++20 -O2 -pthread Benchmark.cxx *.o -o benchmark
+//   ./benchmark [numPositions] [seed] [topdown|bottomup|bnb]
+//
+// The positions only depend on the seed, so runs with the same arguments can be compared.
+#include "Search.hxx"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+using std::array;
+using std::map;
+using std::pair;
+using std::vector;
+
+static const int N = 13;
+static const int K = 4;
+static const int M = 2;
+static const int MAX_NUM_JOKERS = 2;
+static const int MAX_RACK_SIZE = 30;
+static const int RACK_BUCKET_SIZE = 5;
+
+// Generates a board of valid sets and a rack from the tiles that are left, with up to two jokers
+// placed on either side. Board jokers replace a tile of a set so the set stays valid.
+Position generatePosition(std::mt19937_64& rng) {
+  auto uniform = [&](const int lo, const int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+  };
+
+  array<array<int, N>, K> pool;
+  for (auto& counts : pool) {
+    counts.fill(M);
+  }
+
+  Position position;
+  const int numSetsToTry = uniform(0, 16);
+  for (int i = 0; i < numSetsToTry; ++i) {
+    TileSet s;
+    if (uniform(0, 1) == 0) {
+      const int color = uniform(0, K - 1);
+      const int first = uniform(1, N - 2);
+      const int last = std::min(N, first + uniform(2, 5));
+      for (int value = first; value <= last && pool[color][value - 1] > 0; ++value) {
+        s.tiles.push_back(Tile{value, color});
+      }
+    } else {
+      const int value = uniform(1, N);
+      array<int, K> colors{0, 1, 2, 3};
+      std::shuffle(colors.begin(), colors.end(), rng);
+      const int size = uniform(3, 4);
+      for (int j = 0; j < size && pool[colors[j]][value - 1] > 0; ++j) {
+        s.tiles.push_back(Tile{value, colors[j]});
+      }
+    }
+    if (s.size() < 3) {
+      continue;
+    }
+    for (const Tile& tile : s.tiles) {
+      pool[tile.color][tile.faceValue - 1] -= 1;
+    }
+    position.board.push_back(s);
+  }
+
+  const int numJokers = uniform(0, MAX_NUM_JOKERS);
+  int numJokersInRack = 0;
+  for (int i = 0; i < numJokers; ++i) {
+    if (position.board.empty() || uniform(0, 1) == 0) {
+      numJokersInRack += 1;
+      continue;
+    }
+    TileSet& s = position.board[uniform(0, position.board.size() - 1)];
+    Tile& tile = s.tiles[uniform(0, s.size() - 1)];
+    if (tile.isJoker) {
+      numJokersInRack += 1;
+      continue;
+    }
+    pool[tile.color][tile.faceValue - 1] += 1;
+    tile = Tile{1, 0, true};
+  }
+
+  vector<Tile> remaining;
+  for (int k = 0; k < K; ++k) {
+    for (int n = 0; n < N; ++n) {
+      for (int j = 0; j < pool[k][n]; ++j) {
+        remaining.push_back(Tile{n + 1, k});
+      }
+    }
+  }
+  std::shuffle(remaining.begin(), remaining.end(), rng);
+  const int rackSize =
+      uniform(numJokersInRack, std::min<int>(MAX_RACK_SIZE, numJokersInRack + remaining.size()));
+  for (int i = 0; i < numJokersInRack; ++i) {
+    position.rack.push_back(Tile{1, 0, true});
+  }
+  position.rack.insert(position.rack.end(), remaining.begin(),
+                       remaining.begin() + (rackSize - numJokersInRack));
+  return position;
+}
+
+int numJokers(const Position& position) {
+  int count = 0;
+  for (const auto& s : position.board) {
+    for (const Tile& tile : s.tiles) {
+      count += int(tile.isJoker);
+    }
+  }
+  for (const Tile& tile : position.rack) {
+    count += int(tile.isJoker);
+  }
+  return count;
+}
+
+// prints count, throughput, the latency percentiles of the nanosecond timings and the mean of the
+// states expanded
+void printRow(const char* rack, const char* jokers, vector<int64_t> timings,
+              const vector<int64_t>& states) {
+  std::sort(timings.begin(), timings.end());
+  int64_t total = 0;
+  for (const int64_t t : timings) {
+    total += t;
+  }
+  int64_t totalStates = 0;
+  for (const int64_t s : states) {
+    totalStates += s;
+  }
+  auto percentile = [&](const double p) {
+    const size_t rank = std::max<size_t>(1, size_t(p * timings.size() + 0.999999));
+    return timings[rank - 1] / 1e3;
+  };
+  std::printf("%s,%s,%zu,%.1f,%.1f,%.1f,%.1f,%.1f\n", rack, jokers, timings.size(),
+              timings.size() / (total / 1e9), percentile(0.5), percentile(0.99),
+              timings.back() / 1e3, double(totalStates) / states.size());
+}
+
+int main(int argc, char** argv) {
+  const int numPositions = argc > 1 ? std::atoi(argv[1]) : 20000;
+  const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+  Engine engine = Engine::TopDown;
+  if (argc > 3 && std::strcmp(argv[3], "bottomup") == 0) {
+    engine = Engine::BottomUp;
+  } else if (argc > 3 && std::strcmp(argv[3], "bnb") == 0) {
+    engine = Engine::BranchAndBound;
+  }
+  Solver<> solver;
+  solver.setEngine(engine);
+
+  std::mt19937_64 rng(seed);
+  vector<Position> positions;
+  for (int i = 0; i < numPositions; ++i) {
+    positions.push_back(generatePosition(rng));
+  }
+
+  // warm up the solver of this thread so that the first timings do not include its setup
+  for (int i = 0; i < std::min(numPositions, 100); ++i) {
+    solver.solve(positions[i].board, positions[i].rack);
+  }
+
+  // timings and states expanded by (rack size bucket, number of jokers)
+  map<pair<int, int>, vector<int64_t>> timings;
+  map<pair<int, int>, vector<int64_t>> states;
+  vector<int64_t> allTimings;
+  vector<int64_t> allStates;
+  for (auto& position : positions) {
+    const auto start = std::chrono::steady_clock::now();
+    solver.solve(position.board, position.rack);
+    const auto stop = std::chrono::steady_clock::now();
+    const int64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    timings[{int(position.rack.size()) / RACK_BUCKET_SIZE, numJokers(position)}].push_back(t);
+    allTimings.push_back(t);
+  }
+  // counted in a separate pass so that the counting does not slow down the timed solves
+  for (auto& position : positions) {
+    SolveStats stats;
+    solver.solve(position.board, position.rack, stats);
+    states[{int(position.rack.size()) / RACK_BUCKET_SIZE, numJokers(position)}].push_back(
+        stats.statesExpanded);
+    allStates.push_back(stats.statesExpanded);
+  }
+
+  std::printf("rack,jokers,count,solves_per_second,p50_us,p99_us,max_us,mean_states\n");
+  for (const auto& [key, bucket] : timings) {
+    const auto [rackBucket, jokers] = key;
+    char rack[32];
+    char jokersText[16];
+    std::snprintf(rack, sizeof(rack), "%d-%d", rackBucket * RACK_BUCKET_SIZE,
+                  std::min(MAX_RACK_SIZE, rackBucket * RACK_BUCKET_SIZE + RACK_BUCKET_SIZE - 1));
+    std::snprintf(jokersText, sizeof(jokersText), "%d", jokers);
+    printRow(rack, jokersText, bucket, states[key]);
+  }
+  if (!allTimings.empty()) {
+    printRow("all", "all", allTimings, allStates);
+  }
+}
@@ -0,0 +1,85 @@
+#include "PositionFile.hxx"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PositionFile::~PositionFile() {
+  if (mapped != nullptr) {
+    munmap(mapped, size);
+  }
+}
+
+bool PositionFile::open(const char* path) {
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(PositionFileHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  PositionFileHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != PositionFileHeader::MAGIC || header.version != PositionFileHeader::VERSION ||
+      header.recordSize != sizeof(PositionRecord)) {
+    munmap(data, info.st_size);
+    return false;
+  }
+  madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+  if (mapped != nullptr) {
+    munmap(mapped, size);
+  }
+  mapped = data;
+  size = info.st_size;
+  // a record cut short at the end of the file is left out
+  const auto* first = reinterpret_cast<const PositionRecord*>(static_cast<const char*>(data) +
+                                                               sizeof(PositionFileHeader));
+  inFile = {first, (size - sizeof(PositionFileHeader)) / sizeof(PositionRecord)};
+  return true;
+}
+
+PositionWriter::~PositionWriter() { close(); }
+
+bool PositionWriter::open(const char* path) {
+  close();
+  file = std::fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  const PositionFileHeader header;
+  if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+    // records written after a missing header could not be read back
+    std::fclose(file);
+    file = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void PositionWriter::write(const PositionRecord& record) {
+  if (file != nullptr) {
+    std::fwrite(&record, sizeof(record), 1, file);
+  }
+}
+
+bool PositionWriter::close() {
+  if (file == nullptr) {
+    return true;
+  }
+  const bool written = std::ferror(file) == 0;
+  const bool closed = std::fclose(file) == 0;
+  file = nullptr;
+  return written && closed;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+
+static_assert(std::endian::native == std::endian::little, "position files are little endian");
+
+// A position of the standard game, with up to two copies of a tile, as a fixed-width record. The
+// tiles are kept as counts, two bits per color of a value with color k at bit 2 * k, and the sets
+// of the board only as the links, run boundaries and groups that the solver tries to keep, see
+// Solver::LayoutT.
+// Records are written as they are in memory and a file of them is read in place.
+struct PositionRecord {
+  static constexpr int N = 13;
+  static constexpr int K = 4;
+  static constexpr int MAX_COPIES = 2;
+  static constexpr int MAX_NUM_JOKERS = 255;
+  // the groups of a value that can be kept have no jokers, so there are at most two of them
+  static constexpr int MAX_NUM_GROUPS = 2;
+  static constexpr int32_t NO_SCORE = -1;
+
+  std::array<uint8_t, N> board;   // board[value - 1] counts the tiles of the value on the board
+  std::array<uint8_t, N> rack;    // and rack[value - 1] in the rack
+  std::array<uint8_t, N> links;   // links[value - 1] counts the board runs linking value - 1 to it
+  std::array<uint8_t, N> groups;  // the colors of the board groups of the value, 4 bits each
+  uint8_t numJokersOnBoard;
+  uint8_t numJokersInRack;
+  // the colors of the board runs that end at value - 1 right before another run starts at value,
+  // 4 bits for each of the values 2 to N, see boundaryColors
+  std::array<uint8_t, (N - 1) / 2> boundaries;
+  int32_t expectedScore; // the score of the best play, NO_SCORE if it is not known
+
+  static int count(const uint8_t counts, const int k) { return (counts >> (2 * k)) & 3; }
+  static int groupColors(const uint8_t groups, const int i) { return (groups >> (4 * i)) & 0xf; }
+  static int boundaryShift(const int value) { return 4 * (value % 2); }
+  int boundaryColors(const int value) const {
+    return (boundaries[(value - 2) / 2] >> boundaryShift(value)) & 0xf;
+  }
+};
+static_assert(sizeof(PositionRecord) == 64, "a record is a cache line");
+
+// The first bytes of a position file, the records follow it
+struct PositionFileHeader {
+  static constexpr std::array<char, 8> MAGIC{'R', 'U', 'M', 'M', 'I', 'P', 'O', 'S'};
+  // version 1 records have no run boundaries
+  static constexpr uint32_t VERSION = 2;
+
+  std::array<char, 8> magic = MAGIC;
+  uint32_t version = VERSION;
+  uint32_t recordSize = sizeof(PositionRecord);
+  std::array<uint8_t, 48> reserved{};
+};
+static_assert(sizeof(PositionFileHeader) == sizeof(PositionRecord), "records stay aligned");
+
+// A position file mapped into memory. The records are read in place, without copies.
+class PositionFile {
+public:
+  PositionFile() = default;
+  ~PositionFile();
+  PositionFile(const PositionFile&) = delete;
+  PositionFile& operator=(const PositionFile&) = delete;
+
+  // Maps the file at path. Returns false if it can not be read or is not a position file of this
+  // version.
+  bool open(const char* path);
+
+  std::span<const PositionRecord> records() const { return inFile; }
+
+private:
+  void* mapped = nullptr;
+  size_t size = 0;
+  std::span<const PositionRecord> inFile;
+};
+
+// Writes records to a new position file
+class PositionWriter {
+public:
+  PositionWriter() = default;
+  ~PositionWriter();
+  PositionWriter(const PositionWriter&) = delete;
+  PositionWriter& operator=(const PositionWriter&) = delete;
+
+  // Creates the file at path, replacing any file there, and writes the header. Returns false if
+  // the file can not be written, and then no file is left open.
+  bool open(const char* path);
+  // does nothing if no file is open
+  void write(const PositionRecord& record);
+  // Flushes the records and closes the file, returns false if any of them could not be written
+  bool close();
+
+private:
+  FILE* file = nullptr;
+};
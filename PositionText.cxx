@@ -0,0 +1,122 @@
+#include "PositionText.hxx"
+
+#include <array>
+#include <charconv>
+#include <cstring>
+using std::string;
+using std::vector;
+
+static const int N = 13;
+static const int K = 4;
+static const int M = 2;
+static const int MAX_NUM_JOKERS = 2;
+
+// Reads the tiles of a list up to one of the stop characters or the end of the line. Returns
+// false if a tile can not be read or does not fit the game.
+static bool parseTiles(const char*& p, const char* end, const char* stops, auto&& add) {
+  while (true) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+      ++p;
+    }
+    if (p == end || std::strchr(stops, *p) != nullptr) {
+      return true;
+    }
+    if (*p == 'J') {
+      ++p;
+      add(Tile{1, 0, true});
+      continue;
+    }
+    int color;
+    int value;
+    auto [colorEnd, colorError] = std::from_chars(p, end, color);
+    if (colorError != std::errc() || colorEnd == end || *colorEnd != ',') {
+      return false;
+    }
+    auto [valueEnd, valueError] = std::from_chars(colorEnd + 1, end, value);
+    if (valueError != std::errc() || color < 0 || color >= K || value < 1 || value > N) {
+      return false;
+    }
+    p = valueEnd;
+    add(Tile{value, color});
+  }
+}
+
+bool parsePosition(const char* p, const char* end, Position& position) {
+  position.board.clear();
+  position.rack.clear();
+  std::array<int, K * N> copies{};
+  int numJokers = 0;
+  bool fits = true;
+  auto count = [&](const Tile tile) {
+    int& n = tile.isJoker ? numJokers : copies[tile.color * N + tile.faceValue - 1];
+    n += 1;
+    fits = fits && n <= (tile.isJoker ? MAX_NUM_JOKERS : M);
+  };
+
+  while (true) {
+    position.board.emplace_back();
+    TileSet& s = position.board.back();
+    const bool read = parseTiles(p, end, "|;", [&](const Tile tile) {
+      fits = fits && s.size() < TileSet::MAX_SIZE;
+      if (fits) {
+        s.tiles.push_back(tile);
+        count(tile);
+      }
+    });
+    if (!read || p == end || !fits) {
+      return false;
+    }
+    if (s.tiles.empty()) {
+      position.board.pop_back();
+    }
+    if (*p++ == ';') {
+      break;
+    }
+  }
+  return parseTiles(p, end, "", [&](const Tile tile) {
+    position.rack.push_back(tile);
+    count(tile);
+  }) && fits;
+}
+
+bool isBlank(const char* p, const char* end) {
+  return std::all_of(p, end, [](const char c) { return c == ' ' || c == '\t' || c == '\r'; });
+}
+
+static void appendTile(string& out, const Tile tile) {
+  if (tile.isJoker) {
+    out += 'J';
+    return;
+  }
+  char text[8];
+  char* p = std::to_chars(text, text + sizeof(text), int(tile.color)).ptr;
+  *p++ = ',';
+  p = std::to_chars(p, text + sizeof(text), int(tile.faceValue)).ptr;
+  out.append(text, p);
+}
+
+void appendResult(string& out, const int score, const vector<TileSet>& sets,
+                         const vector<Tile>& played) {
+  char text[16];
+  out.append(text, std::to_chars(text, text + sizeof(text), score).ptr);
+  out += ';';
+  for (size_t i = 0; i < sets.size(); ++i) {
+    for (size_t j = 0; j < sets[i].tiles.size(); ++j) {
+      if (j > 0) {
+        out += ' ';
+      }
+      appendTile(out, sets[i].tiles[j]);
+    }
+    if (i + 1 < sets.size()) {
+      out += '|';
+    }
+  }
+  out += ';';
+  for (size_t i = 0; i < played.size(); ++i) {
+    if (i > 0) {
+      out += ' ';
+    }
+    appendTile(out, played[i]);
+  }
+  out += '\n';
+}
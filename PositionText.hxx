@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Search.hxx"
+#include "Tile.hxx"
+#include "TileSet.hxx"
+#include <string>
+#include <vector>
+
+// Positions of the standard game as lines of text, as rummikub-solve reads and prints them. A
+// position is the board and the rack separated by ';'. The board is a list of sets separated by
+// '|', and a set or the rack is a list of tiles separated by spaces. A tile is color,faceValue
+// with the color from 0 to 3, or J for a joker:
+//
+//   0,3 0,4 0,5 | 1,7 2,7 J ; 3,1 0,6 J
+
+// Reads the line from p to end, without its newline, into the board and rack of the position,
+// reusing their memory. Returns false if the line is not a position of the game, including when it
+// has more copies of a tile than the game does.
+bool parsePosition(const char* p, const char* end, Position& position);
+
+// Whether the line only holds spaces, tabs or '\r', it has no position to read
+bool isBlank(const char* p, const char* end);
+
+// Appends the line of a solved position: the score of the play, the sets of the new board and the
+// tiles played from the rack, in the format of the positions
+//
+//   31;J 1,7 2,7|0,3 0,4 0,5 0,6 J;0,6 J
+void appendResult(std::string& out, int score, const std::vector<TileSet>& sets,
+                  const std::vector<Tile>& played);
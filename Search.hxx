@@ -1,9 +1,54 @@
 #pragma once
 
+#include "PositionFile.hxx"
+#include "Solver.hxx"
+#include "ThreadPool.hxx"
 #include "Tile.hxx"
 #include "TileSet.hxx"
+#include <array>
+#include <span>
 #include <utility>
 #include <vector>
 
+// the standard game, the solver used by the functions below
+extern template class Solver<>;
+
 std::vector<TileSet> getTileSetsIfValid(std::vector<Tile> tiles);
-std::pair<std::vector<TileSet>, std::vector<Tile>> solve(std::vector<TileSet>& board, std::vector<Tile>& rack);
\ No newline at end of file
+// Whether the tiles can be arranged into valid sets, see Solver::isValid
+bool isValid(const std::vector<Tile>& tiles);
+std::pair<std::vector<TileSet>, std::vector<Tile>> solve(std::vector<TileSet>& board, std::vector<Tile>& rack);
+std::pair<std::vector<TileSet>, std::vector<Tile>> solve(std::vector<TileSet>& board, std::vector<Tile>& rack,
+                                                         SolveStats& stats);
+// Same as solve(board, rack) for the position of the record, see Solver::solve
+std::pair<std::vector<TileSet>, std::vector<Tile>> solve(const PositionRecord& record);
+
+// the score of playing the tiles, as solve scores them
+int playScore(const std::vector<Tile>& played);
+
+// Writes the position of every later call of solve(board, rack) and solveBatch, with the score of
+// the play found, to a new position file at path until stopCapture is called. Returns false if the
+// file can not be created. Solves from every thread are captured, in the order they finish, and
+// the positions of a solveBatch are written together in their order.
+bool startCapture(const char* path);
+// Returns false if some of the positions could not be written
+bool stopCapture();
+
+// The k best configurations, best first, none if k is not positive, see Solver::solveTopK
+std::vector<std::pair<std::vector<TileSet>, std::vector<Tile>>>
+solveTopK(std::vector<TileSet>& board, std::vector<Tile>& rack, int k);
+
+// The score of the best play after drawing each tile, as playScore scores the tiles it plays from
+// the rack, see Solver::drawValueTable
+std::array<int, 4 * 13 + 1> drawValueTable(std::vector<TileSet>& board, std::vector<Tile>& rack);
+
+struct Position {
+  std::vector<TileSet> board;
+  std::vector<Tile> rack;
+};
+
+// Solves every position on the threads of the pool, each thread reusing its own Solver.
+// The results are in the same order as the positions.
+std::vector<std::pair<std::vector<TileSet>, std::vector<Tile>>>
+solveBatch(std::span<Position> positions, ThreadPool& pool);
+std::vector<std::pair<std::vector<TileSet>, std::vector<Tile>>>
+solveBatch(std::span<Position> positions);
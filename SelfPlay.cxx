@@ -0,0 +1,51 @@
+// Plays games between players who make the best play that solve finds, on every core, and prints
+// the throughput and the outcomes as CSV: one row for the games, then one row per seat.
+//
+//   g++ -std=c++20 -O2 -c Position*.cxx Search.cxx Simulator.cxx TileSet.cxx ThreadPool.cxx
+//   g++ -std=c++20 -O2 -pthread SelfPlay.cxx *.o -o selfplay
+//   ./selfplay [numGames] [seed] [numPlayers] [initialMeld] [numThreads]
+//
+// The games only depend on the seed and the rules, so runs with the same arguments can be
+// compared whatever the number of threads.
+#include "Simulator.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+int main(int argc, char** argv) {
+  const int64_t numGames = argc > 1 ? std::atoll(argv[1]) : 1000;
+  const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+  GameRules rules;
+  if (argc > 3) {
+    rules.numPlayers = std::atoi(argv[3]);
+  }
+  if (argc > 4) {
+    rules.initialMeld = std::atoi(argv[4]);
+  }
+  if (rules.numPlayers < 2 || rules.numPlayers > GameRules::MAX_NUM_PLAYERS) {
+    std::fprintf(stderr, "the number of players must be from 2 to %d\n",
+                 GameRules::MAX_NUM_PLAYERS);
+    return 2;
+  }
+  ThreadPool pool(argc > 5 ? std::atoi(argv[5]) : std::thread::hardware_concurrency());
+
+  const auto start = std::chrono::steady_clock::now();
+  const SimulationStats stats = simulate(rules, numGames, seed, pool);
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const double games = std::max<double>(1, stats.games);
+  std::printf("games,threads,seconds,games_per_second,games_per_hour,blocked,mean_turns,"
+              "mean_plays\n");
+  std::printf("%lld,%d,%.2f,%.1f,%.0f,%.4f,%.1f,%.1f\n", static_cast<long long>(stats.games),
+              pool.size(), seconds, stats.games / seconds, stats.games / seconds * 3600,
+              stats.blocked / games, stats.turns / games, stats.plays / games);
+  std::printf("seat,wins,win_rate,mean_points\n");
+  for (int player = 0; player < rules.numPlayers; ++player) {
+    std::printf("%d,%lld,%.4f,%.2f\n", player, static_cast<long long>(stats.wins[player]),
+                stats.wins[player] / games, stats.points[player] / games);
+  }
+}
@@ -0,0 +1,187 @@
+#include "Simulator.hxx"
+
+#include "Search.hxx"
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+using std::array;
+using std::vector;
+
+static const int N = 13;
+static const int K = 4;
+static const int M = 2;
+static const int NUM_JOKERS = 2;
+
+// the value of a set of a first play, a joker is worth the value it stands for
+static int meldValue(const TileSet& s) {
+  const auto tile =
+      std::find_if(s.tiles.begin(), s.tiles.end(), [](const Tile& t) { return !t.isJoker; });
+  if (tile == s.tiles.end()) {
+    return 0;
+  }
+  if (s.isGroup()) {
+    return tile->faceValue * int(s.size());
+  }
+  // the tiles of a run are in order
+  const int firstValue = tile->faceValue - int(tile - s.tiles.begin());
+  return int(s.size()) * (2 * firstValue + int(s.size()) - 1) / 2;
+}
+
+static int rackPenalty(const vector<Tile>& rack, const GameRules& rules) {
+  int penalty = 0;
+  for (const Tile& tile : rack) {
+    penalty += tile.isJoker ? rules.jokerPenalty : tile.faceValue;
+  }
+  return penalty;
+}
+
+// removes the played tiles from the rack, a joker stands for any joker
+static void removePlayed(vector<Tile>& rack, const vector<Tile>& played) {
+  for (const Tile& p : played) {
+    const auto tile = std::find_if(rack.begin(), rack.end(), [&](const Tile& t) {
+      return p.isJoker ? bool(t.isJoker)
+                       : !t.isJoker && t.faceValue == p.faceValue && t.color == p.color;
+    });
+    // the solver only plays tiles of the rack
+    assert(tile != rack.end());
+    *tile = rack.back();
+    rack.pop_back();
+  }
+}
+
+GameResult playGame(const GameRules& rules, std::mt19937_64& rng) {
+  vector<Tile> pool;
+  pool.reserve(K * N * M + NUM_JOKERS);
+  for (int copy = 0; copy < M; ++copy) {
+    for (int k = 0; k < K; ++k) {
+      for (int value = 1; value <= N; ++value) {
+        pool.push_back(Tile{value, k});
+      }
+    }
+  }
+  for (int i = 0; i < NUM_JOKERS; ++i) {
+    pool.push_back(Tile{1, 0, true});
+  }
+  std::shuffle(pool.begin(), pool.end(), rng);
+
+  // the pool is drawn from its end
+  array<vector<Tile>, GameRules::MAX_NUM_PLAYERS> racks;
+  array<bool, GameRules::MAX_NUM_PLAYERS> melded{};
+  for (int player = 0; player < rules.numPlayers; ++player) {
+    racks[player].assign(pool.end() - rules.numDealt, pool.end());
+    pool.resize(pool.size() - rules.numDealt);
+  }
+
+  GameResult result;
+  vector<TileSet> board;
+  vector<TileSet> noBoard;
+  int passes = 0; // turns in a row where nothing was played or drawn
+  for (int player = 0; result.turns < rules.maxTurns && passes < rules.numPlayers;
+       player = (player + 1) % rules.numPlayers) {
+    result.turns += 1;
+    vector<Tile>& rack = racks[player];
+    // until their first play, a player can only play sets of their own tiles next to the board
+    const bool firstPlay = !melded[player] && rules.initialMeld > 0;
+    auto [sets, played] = solve(firstPlay ? noBoard : board, rack);
+    if (firstPlay && !played.empty()) {
+      int value = 0;
+      for (const TileSet& s : sets) {
+        value += meldValue(s);
+      }
+      if (value < rules.initialMeld) {
+        played.clear();
+      } else {
+        board.insert(board.end(), sets.begin(), sets.end());
+      }
+    } else if (!played.empty()) {
+      board = std::move(sets);
+    }
+
+    if (!played.empty()) {
+      melded[player] = true;
+      removePlayed(rack, played);
+      result.plays += 1;
+      passes = 0;
+      if (rack.empty()) {
+        result.winner = player;
+        break;
+      }
+    } else if (!pool.empty()) {
+      rack.push_back(pool.back());
+      pool.pop_back();
+      passes = 0;
+    } else {
+      passes += 1;
+    }
+  }
+
+  result.poolTiles = pool.size();
+  for (const TileSet& s : board) {
+    result.boardTiles += s.size();
+  }
+  array<int, GameRules::MAX_NUM_PLAYERS> penalties{};
+  for (int player = 0; player < rules.numPlayers; ++player) {
+    penalties[player] = rackPenalty(racks[player], rules);
+    result.rackTiles[player] = racks[player].size();
+  }
+  if (result.winner < 0) {
+    result.blocked = true;
+    result.winner = int(std::min_element(penalties.begin(), penalties.begin() + rules.numPlayers) -
+                        penalties.begin());
+  }
+  for (int player = 0; player < rules.numPlayers; ++player) {
+    if (player != result.winner) {
+      result.points[player] = -penalties[player];
+      result.points[result.winner] += penalties[player];
+    }
+  }
+  return result;
+}
+
+void SimulationStats::add(const GameResult& result) {
+  games += 1;
+  blocked += int(result.blocked);
+  turns += result.turns;
+  plays += result.plays;
+  wins[result.winner] += 1;
+  for (int player = 0; player < GameRules::MAX_NUM_PLAYERS; ++player) {
+    points[player] += result.points[player];
+  }
+}
+
+SimulationStats& SimulationStats::operator+=(const SimulationStats& other) {
+  games += other.games;
+  blocked += other.blocked;
+  turns += other.turns;
+  plays += other.plays;
+  for (int player = 0; player < GameRules::MAX_NUM_PLAYERS; ++player) {
+    wins[player] += other.wins[player];
+    points[player] += other.points[player];
+  }
+  return *this;
+}
+
+SimulationStats simulate(const GameRules& rules, const int64_t numGames, const uint64_t seed,
+                         ThreadPool& pool) {
+  // the stats of each worker, on their own cache lines
+  struct alignas(64) WorkerStats {
+    SimulationStats stats;
+  };
+  const auto workerStats = std::make_unique<WorkerStats[]>(pool.size());
+  pool.parallelFor(numGames, [&](size_t game, int worker) {
+    std::mt19937_64 rng(seed * 0x9e3779b97f4a7c15 + game);
+    workerStats[worker].stats.add(playGame(rules, rng));
+  });
+
+  SimulationStats stats;
+  for (int worker = 0; worker < pool.size(); ++worker) {
+    stats += workerStats[worker].stats;
+  }
+  return stats;
+}
+
+SimulationStats simulate(const GameRules& rules, const int64_t numGames, const uint64_t seed) {
+  return simulate(rules, numGames, seed, ThreadPool::shared());
+}
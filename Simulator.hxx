@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ThreadPool.hxx"
+#include "Tile.hxx"
+#include "TileSet.hxx"
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// The rules of the simulated games. The tiles are those of the standard game, two copies of every
+// tile and two jokers.
+struct GameRules {
+  static constexpr int MAX_NUM_PLAYERS = 4;
+
+  int numPlayers = 4;
+  int numDealt = 14; // tiles dealt to each player
+  // the least value of the first play of a player, made of sets from their own tiles only, where
+  // a joker is worth the value it stands for. 0 lets the first play use the board.
+  int initialMeld = 30;
+  int jokerPenalty = 30; // what a joker left in a rack costs at the end
+  int maxTurns = 1000;   // a game that lasts longer is blocked
+};
+
+// How a game ended. Every player loses the value of the tiles left in their rack and the winner
+// gains what the others lose.
+struct GameResult {
+  int winner = -1;
+  bool blocked = false; // nobody went out, the pool ran out and every player passed
+  int turns = 0;
+  int plays = 0; // turns where tiles were played
+  std::array<int, GameRules::MAX_NUM_PLAYERS> points{};
+  // where the tiles are at the end of the game
+  int poolTiles = 0;
+  int boardTiles = 0;
+  std::array<int, GameRules::MAX_NUM_PLAYERS> rackTiles{};
+};
+
+// Plays a game between players who each make the best play that solve finds. A player who can
+// not play draws a tile, or passes once the pool is empty. The game ends when a player plays all
+// of their tiles. A blocked game is won by the player with the least value left.
+GameResult playGame(const GameRules& rules, std::mt19937_64& rng);
+
+// What a batch of games added up to
+struct SimulationStats {
+  int64_t games = 0;
+  int64_t blocked = 0;
+  int64_t turns = 0;
+  int64_t plays = 0;
+  std::array<int64_t, GameRules::MAX_NUM_PLAYERS> wins{};
+  std::array<int64_t, GameRules::MAX_NUM_PLAYERS> points{};
+
+  void add(const GameResult& result);
+  SimulationStats& operator+=(const SimulationStats& other);
+};
+
+// Plays the games on the threads of the pool, each thread reusing its own solver. The tiles of
+// game i are shuffled by a generator seeded with seed and i, so the stats do not depend on the
+// number of threads.
+SimulationStats simulate(const GameRules& rules, int64_t numGames, uint64_t seed, ThreadPool& pool);
+SimulationStats simulate(const GameRules& rules, int64_t numGames, uint64_t seed);
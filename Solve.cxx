@@ -0,0 +1,262 @@
+// Solves a file of positions, one per line, on every core and prints one line per position in the
+// same order. Lines that are empty or only hold spaces, tabs or '\r' are skipped and print nothing.
+//
+//   g++ -std=c++20 -O2 -c Position*.cxx Search.cxx Simulator.cxx TileSet.cxx ThreadPool.cxx
+//   g++ -std=c++20 -O2 -pthread Solve.cxx *.o -o rummikub-solve
+//   ./rummikub-solve positions [numThreads] [capture.pos] > results.txt
+//
+// A position is the board and the rack separated by ';', see PositionText.hxx. The board is a list
+// of sets separated by '|', and a set or the rack is a list of tiles separated by spaces. A tile is
+// color,faceValue with the color from 0 to 3, or J for a joker:
+//
+//   0,3 0,4 0,5 | 1,7 2,7 J ; 3,1 0,6 J
+//
+// The result is the score of the best play, the sets of the new board and the tiles played from
+// the rack, in the same format, or "invalid" for a line that is not a position of the standard
+// game:
+//
+//   31;J 1,7 2,7|0,3 0,4 0,5 0,6 J;0,6 J
+//
+// The positions can also be a position file, see PositionFile.hxx, whose records are solved in
+// place. Then a record that has an expected score and scores differently is an error, and so is a
+// position file of another version or one cut short before its header ends. With
+// capture.pos, the positions of a text file are also written to a new position file with the
+// scores found, in the same order, for replaying them later. A capture is an error for a position
+// file, and so is a capture that is the text file itself.
+//
+// The input is mapped into memory and split into chunks of lines that the threads take in order.
+// The output of a chunk, and its captured positions, are written once the chunks before it have
+// been written, and the threads stop taking chunks while too many finished chunks are waiting for
+// that.
+#include "PositionText.hxx"
+#include "Search.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using std::string;
+using std::vector;
+
+static const size_t CHUNK_BYTES = 16 * 1024;
+static const size_t CHUNK_RECORDS = CHUNK_BYTES / sizeof(PositionRecord);
+// the chunks that a thread can be ahead of the next chunk to be written
+static const size_t CHUNKS_PER_THREAD = 4;
+
+// The lines that a chunk prints and the positions that it captures
+struct ChunkOutput {
+  string text;
+  vector<PositionRecord> records;
+};
+
+// The output of the chunks that are being solved or wait to be written. A chunk gets a slot once
+// it is less than a window ahead of the next chunk to be written, and the slots are written in
+// order of the chunks as they finish. The records go to capture, if there is one.
+class ReorderBuffer {
+public:
+  ReorderBuffer(size_t window, FILE* out, PositionWriter* capture)
+      : slots(window), finished(window), out(out), capture(capture) {}
+
+  // Waits until the chunk is in the window and returns the empty output of its slot
+  ChunkOutput& start(size_t chunk) {
+    std::unique_lock lock(mutex);
+    inWindow.wait(lock, [&] { return chunk < nextChunk + slots.size(); });
+    ChunkOutput& slot = slots[chunk % slots.size()];
+    slot.text.clear();
+    slot.records.clear();
+    return slot;
+  }
+
+  // Writes the output of the chunk and of the finished chunks after it, if the chunks before it
+  // are written
+  void finish(size_t chunk) {
+    {
+      std::lock_guard lock(mutex);
+      finished[chunk % slots.size()] = true;
+      while (finished[nextChunk % slots.size()]) {
+        const ChunkOutput& slot = slots[nextChunk % slots.size()];
+        std::fwrite(slot.text.data(), 1, slot.text.size(), out);
+        for (const PositionRecord& record : slot.records) {
+          capture->write(record);
+        }
+        finished[nextChunk % slots.size()] = false;
+        nextChunk += 1;
+      }
+    }
+    inWindow.notify_all();
+  }
+
+private:
+  vector<ChunkOutput> slots;
+  vector<char> finished;
+  FILE* out;
+  PositionWriter* capture;
+  size_t nextChunk = 0;
+  std::mutex mutex;
+  std::condition_variable inWindow;
+};
+
+// the first line that starts at or after offset
+static const char* lineStart(const char* data, const size_t size, const size_t offset) {
+  if (offset == 0) {
+    return data;
+  }
+  if (offset >= size) {
+    return data + size;
+  }
+  const void* newline = std::memchr(data + offset - 1, '\n', size - offset + 1);
+  return newline == nullptr ? data + size : static_cast<const char*>(newline) + 1;
+}
+
+// Solves the chunks on the threads of the pool and writes their output in order,
+// solveChunk(chunk, worker, out) appends the output of a chunk to out, and the records it adds to
+// out go to capture
+static void solveChunks(ThreadPool& pool, const size_t numChunks, PositionWriter* capture,
+                        const auto& solveChunk) {
+  ReorderBuffer output(pool.size() * CHUNKS_PER_THREAD, stdout, capture);
+  std::atomic<size_t> nextChunk = 0;
+  // every worker takes chunks until there are none left
+  pool.parallelFor(pool.size(), [&](size_t, int worker) {
+    for (size_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++) {
+      ChunkOutput& out = output.start(chunk);
+      solveChunk(chunk, worker, out);
+      output.finish(chunk);
+    }
+  });
+  std::fflush(stdout);
+}
+
+// Solves the lines of a text file and returns the number of invalid lines. The lines of a chunk
+// are those that start in its bytes. Writes the positions with their scores to capture, if there is
+// one.
+static int64_t solveLines(ThreadPool& pool, const char* data, const size_t size,
+                          PositionWriter* capture) {
+  vector<Position> positions(pool.size());
+  std::atomic<int64_t> numInvalid = 0;
+  const size_t numChunks = (size + CHUNK_BYTES - 1) / CHUNK_BYTES;
+  solveChunks(pool, numChunks, capture, [&](size_t chunk, int worker, ChunkOutput& out) {
+    Position& position = positions[worker];
+    const char* end = lineStart(data, size, (chunk + 1) * CHUNK_BYTES);
+    for (const char* line = lineStart(data, size, chunk * CHUNK_BYTES); line < end;) {
+      const char* newline = static_cast<const char*>(std::memchr(line, '\n', data + size - line));
+      const char* lineEnd = newline == nullptr ? data + size : newline;
+      if (isBlank(line, lineEnd)) {
+        line = lineEnd + 1;
+        continue;
+      }
+      if (parsePosition(line, lineEnd, position)) {
+        const auto [sets, played] = solve(position.board, position.rack);
+        const int score = playScore(played);
+        appendResult(out.text, score, sets, played);
+        if (capture != nullptr) {
+          out.records.push_back(Solver<>::toRecord(position.board, position.rack));
+          out.records.back().expectedScore = score;
+        }
+      } else {
+        out.text += "invalid\n";
+        numInvalid += 1;
+      }
+      line = lineEnd + 1;
+    }
+  });
+  return numInvalid;
+}
+
+// Solves the records of a position file in place and returns the number of positions whose score
+// is not the one they expect
+static int64_t solveRecords(ThreadPool& pool, const std::span<const PositionRecord> records) {
+  std::atomic<int64_t> numDifferent = 0;
+  const size_t numChunks = (records.size() + CHUNK_RECORDS - 1) / CHUNK_RECORDS;
+  solveChunks(pool, numChunks, nullptr, [&](size_t chunk, int, ChunkOutput& out) {
+    const size_t end = std::min(records.size(), (chunk + 1) * CHUNK_RECORDS);
+    for (size_t i = chunk * CHUNK_RECORDS; i < end; ++i) {
+      const auto [sets, played] = solve(records[i]);
+      const int score = playScore(played);
+      appendResult(out.text, score, sets, played);
+      const int32_t expected = records[i].expectedScore;
+      numDifferent += int(expected != PositionRecord::NO_SCORE && expected != score);
+    }
+  });
+  return numDifferent;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s positions [numThreads] [capture.pos]\n", argv[0]);
+    return 2;
+  }
+  ThreadPool pool(argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency());
+  PositionWriter capture;
+
+  int64_t numInvalid = 0;
+  int64_t numDifferent = 0;
+  PositionFile file;
+  if (file.open(argv[1])) {
+    if (argc > 3) {
+      std::fprintf(stderr, "%s: only the positions of a text file are captured\n", argv[3]);
+      return 2;
+    }
+    numDifferent = solveRecords(pool, file.records());
+  } else {
+    const int fd = open(argv[1], O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      std::perror(argv[1]);
+      return 1;
+    }
+    // opening the capture truncates it, so it must not be the input
+    struct stat captureInfo;
+    if (argc > 3 && stat(argv[3], &captureInfo) == 0 && captureInfo.st_dev == info.st_dev &&
+        captureInfo.st_ino == info.st_ino) {
+      std::fprintf(stderr, "%s: the capture would replace the positions\n", argv[3]);
+      return 2;
+    }
+    const size_t size = info.st_size;
+    const char* data = "";
+    if (size > 0) {
+      void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED) {
+        std::perror(argv[1]);
+        return 1;
+      }
+      madvise(mapped, size, MADV_SEQUENTIAL);
+      data = static_cast<const char*>(mapped);
+    }
+    // a position file that PositionFile did not take is not read as text
+    const auto& magic = PositionFileHeader::MAGIC;
+    if (size >= magic.size() && std::memcmp(data, magic.data(), magic.size()) == 0) {
+      std::fprintf(stderr, "%s: not a position file of version %u, or cut short\n", argv[1],
+                   PositionFileHeader::VERSION);
+      return 1;
+    }
+    if (argc > 3 && !capture.open(argv[3])) {
+      std::perror(argv[3]);
+      return 1;
+    }
+    numInvalid = solveLines(pool, data, size, argc > 3 ? &capture : nullptr);
+  }
+
+  if (!capture.close()) {
+    std::fprintf(stderr, "%s: could not write every position\n", argv[3]);
+    return 1;
+  }
+  if (numInvalid > 0) {
+    std::fprintf(stderr, "%lld invalid lines\n", static_cast<long long>(numInvalid));
+  }
+  if (numDifferent > 0) {
+    std::fprintf(stderr, "%lld positions scored differently than expected\n",
+                 static_cast<long long>(numDifferent));
+  }
+  return numInvalid > 0 || numDifferent > 0 ? 1 : 0;
+}
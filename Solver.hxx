@@ -0,0 +1,2207 @@
+#pragma once
+
+#include "PositionFile.hxx"
+#include "ThreadPool.hxx"
+#include "Tile.hxx"
+#include "TileSet.hxx"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// The ways to fill the dynamic programming table, they find the same configurations
+enum class Engine {
+  TopDown,  // memoized recursion over the states reachable from the first value
+  BottomUp, // fills the table value by value from the last value down to 1 over every run state
+  // top down, skipping the ways to play whose upper bound can not beat the best play found so far
+  BranchAndBound,
+};
+
+// How the dynamic programming table is stored, they find the same configurations
+enum class TableMode {
+  Dense,   // an entry for every run state, allocated once and reused by every solve
+  Compact, // only the entries of the states that a solve reaches, small enough to stay in the cache
+};
+
+// What a single solve did, filled by Solver::solve when it is given one. Only the serial search
+// counts, and memo hits are only counted by the top down engines.
+struct SolveStats {
+  int64_t statesExpanded = 0; // entries of the dynamic programming table that were computed
+  int64_t memoHits = 0;       // entries that were found already computed
+  int64_t boundCutoffs = 0;   // ways to play skipped by the branch and bound engine
+  int64_t fanOut = 0;         // ways to play tiles into runs tried, over every expanded state
+  int64_t maxFanOut = 0;      // most ways to play tiles into runs tried at a single state
+  int64_t groupLookups = 0;
+  int64_t tableConstraintRejections = 0;
+  // time spent counting the tiles, searching and rebuilding the sets of the best configuration
+  std::chrono::nanoseconds arrayTime{0};
+  std::chrono::nanoseconds searchTime{0};
+  std::chrono::nanoseconds reconstructionTime{0};
+};
+
+// Scoring policies for Solver. The score of a play is the sum of tile(value) over its tiles and
+// joker(value) over its jokers, where value is the face value that the joker stands for. Scores
+// must not be negative, a negative total marks an invalid configuration.
+
+// The standard score. FaceValueScoring<0> only plays a joker if it lets more of the other tiles
+// be played.
+template <int JokerValue = 25>
+struct FaceValueScoring {
+  static constexpr int tile(const int value) { return value; }
+  static constexpr int joker(const int) { return JokerValue; }
+};
+
+// maximizes the number of tiles played
+struct TileCountScoring {
+  static constexpr int tile(const int) { return 1; }
+  static constexpr int joker(const int) { return 1; }
+};
+
+// Finds the maximum value play for the rules with face values 1 to N, K colors, M copies of every
+// tile and up to J jokers, where the value of a play is given by Scoring. The defaults are the
+// standard game. N is at most 13, the longest run that TileSet allows.
+//
+// Owns the dynamic programming tables used by the search so that they can be reused across calls.
+// Solvers do not share any state, but a single Solver must only be used by one thread at a time.
+template <int N = 13, int K = 4, int M = 2, int J = 2, typename Scoring = FaceValueScoring<>>
+class Solver {
+  static_assert(N >= 3, "a run needs three face values");
+  static_assert(K >= 3 && K <= 8, "a group needs three colors, and groups are stored as bytes");
+  static_assert(M >= 1 && M <= 4, "the runs of a color are stored as base 4 digits in a byte");
+  static_assert(J >= 0 && J <= 8);
+  static_assert(N <= TileSet::MAX_FACE_VALUE, "TileSet only allows runs of the standard values");
+
+public:
+  Solver() = default;
+  Solver(const Solver&) = delete;
+  Solver& operator=(const Solver&) = delete;
+
+  // The compact table is always searched by the serial top down engine, or the branch and bound
+  // engine. Rules whose tables are too large to allocate densely always use the compact table.
+  // Parallel solves with the branch and bound engine use the top down engine.
+  void setEngine(Engine engine) { this->engine = engine; }
+  void setTableMode(TableMode tableMode) { this->tableMode = tableMode; }
+
+  // Used for testing. Gets the tilesets if the input tiles can be arranged into a valid
+  // configuration
+  std::vector<TileSet> getTileSetsIfValid(std::vector<Tile> tiles) {
+    int numJokersOnTable = 0;
+    CountsT table{};
+    for (auto tile : tiles) {
+      if (tile.isJoker) {
+        numJokersOnTable += 1;
+      } else {
+        table.add(tile.color, tile.faceValue);
+      }
+    }
+    CountsT hand{};
+    NoStats stats;
+    lastChangedValue = N;
+    return withContext([&](auto& context) -> std::vector<TileSet> {
+      context.layout = {};
+      const int maxscore = runEngine(context, table, hand, numJokersOnTable, 0, N, stats);
+      if (maxscore <= 0) {
+        return {};
+      }
+      return getTileSetsFromMemo(context, table, numJokersOnTable).first;
+    });
+  }
+
+  // Whether the tiles can be arranged into valid sets, the same answer as getTileSetsIfValid gives
+  // for tiles that score. Much cheaper, only the reachable states of each value are tracked,
+  // without scores or choices, and the search stops at the first valid arrangement.
+  bool isValid(const std::vector<Tile>& tiles) {
+    int numJokers = 0;
+    CountsT table{};
+    for (const Tile& tile : tiles) {
+      if (tile.isJoker) {
+        numJokers += 1;
+      } else {
+        table.add(tile.color, tile.faceValue);
+      }
+    }
+    if (numJokers > MAX_NUM_JOKERS) {
+      return false;
+    }
+    CountsT counts = table;
+    const bool found = isFeasible(1, NO_RUNS, 0, counts, table, numJokers, deadStates);
+    deadStates.clear();
+    return found;
+  }
+
+  std::pair<std::vector<TileSet>, std::vector<Tile>> solve(std::vector<TileSet>& board,
+                                                           std::vector<Tile>& rack) {
+    NoStats stats;
+    return serialSolve(
+        getLayout(board), [&] { return getArraysFromTileSets(board, rack); }, stats);
+  }
+
+  // Same as solve, and replaces stats with what the search did. Solves without stats are not
+  // slowed down by the counting.
+  std::pair<std::vector<TileSet>, std::vector<Tile>>
+  solve(std::vector<TileSet>& board, std::vector<Tile>& rack, SolveStats& stats) {
+    stats = {};
+    return serialSolve(
+        getLayout(board), [&] { return getArraysFromTileSets(board, rack); }, stats);
+  }
+
+  // Same result as solve, but the search is split between the threads of the pool. The top down
+  // engine searches the ways to play the tiles of value 1 in parallel, the bottom up engine fills
+  // the states of each value in parallel. Only worth it for slow positions.
+  std::pair<std::vector<TileSet>, std::vector<Tile>>
+  solve(std::vector<TileSet>& board, std::vector<Tile>& rack, ThreadPool& pool) {
+    if constexpr (DENSE) {
+      if (tableMode == TableMode::Dense) {
+        NoStats stats;
+        lastChangedValue = N;
+        DenseContext& context = denseContext();
+        context.layout = getLayout(board);
+        return solveWith(
+            context, [&] { return getArraysFromTileSets(board, rack); }, stats,
+            [&](const auto&... arrays) {
+              if (engine == Engine::BottomUp) {
+                return bottomUpMaxScore(context, arrays..., &pool, N, stats);
+              }
+              return parallelMaxScore(context, arrays..., pool);
+            });
+      }
+    }
+    return solve(board, rack);
+  }
+
+  // The k best configurations, best first. They are the k best ways to play of the search, so the
+  // first one is the configuration solve returns and fewer than k are returned if there are not
+  // enough valid plays. Every state of the search keeps its k best ways to play instead of one.
+  // Nothing is searched and nothing is returned if k is not positive.
+  std::vector<std::pair<std::vector<TileSet>, std::vector<Tile>>>
+  solveTopK(std::vector<TileSet>& board, std::vector<Tile>& rack, const int k) {
+    if (k <= 0) {
+      return {};
+    }
+    CountsT table;
+    CountsT hand;
+    int numJokersOnTable;
+    int numJokersInHand;
+    std::tie(table, hand, numJokersOnTable, numJokersInHand) = getArraysFromTileSets(board, rack);
+
+    TopKMemo memo(k, getLayout(board));
+    CountsT tiles = getTiles(table, hand);
+    CountsT constraint = table;
+    const auto [begin, end] = _topScores(1, NO_RUNS, 0, tiles, constraint, memo, numJokersOnTable,
+                                         numJokersOnTable + numJokersInHand);
+
+    std::vector<std::pair<std::vector<TileSet>, std::vector<Tile>>> results;
+    for (uint32_t i = begin; i < end && memo.ranked[i].score > 0; ++i) {
+      int rank = i - begin;
+      CountsT remaining = table;
+      results.push_back(getTileSetsFromChoices(
+          remaining, numJokersOnTable,
+          [&](const int value, const StateT state, const int numJokersUsed) {
+            const uint32_t begin = memo.ranges.at(TopKMemo::key(value, state, numJokersUsed)).first;
+            const RankedT& entry = memo.ranked[begin + rank];
+            rank = entry.next;
+            return entry.choice;
+          }));
+    }
+    return results;
+  }
+
+  // The score of the best play after drawing each tile into the rack, the score of the tiles it
+  // plays from the rack like playScore of the tiles that solve returns. A face is at
+  // color * N + faceValue - 1 and a joker is last. A tile whose copies are all on the board or in
+  // the rack can not be drawn and gets the score of the best play of the current position. Costs
+  // about ten solves of the current position on the positions of Benchmark.cxx, against about
+  // thirty for solving every draw, see drawScores.
+  std::array<int, K * N + 1> drawValueTable(std::vector<TileSet>& board, std::vector<Tile>& rack) {
+    lastChangedValue = N;
+    CountsT table;
+    CountsT hand;
+    int numJokersOnTable;
+    int numJokersInHand;
+    std::tie(table, hand, numJokersOnTable, numJokersInHand) = getArraysFromTileSets(board, rack);
+    return withContext([&](auto& context) {
+      context.layout = getLayout(board);
+      return drawScores(context, table, hand, numJokersOnTable, numJokersInHand);
+    });
+  }
+
+  // The solver also keeps a position that can be changed a few tiles at a time. Solving it only
+  // recomputes the table entries of the values up to the largest face value that changed, or all
+  // of them if a joker changed. The other solve functions do not change this position, but they
+  // reuse the table so the next solve of this position starts over.
+  void setBoard(const std::vector<TileSet>& board) {
+    std::vector<Tile> tiles;
+    for (const auto& s : board) {
+      tiles.insert(tiles.end(), s.tiles.begin(), s.tiles.end());
+    }
+    setCounts(tiles, boardCounts, numJokersOnBoard);
+
+    const LayoutT layout = getLayout(board);
+    for (int value = 1; value <= N; ++value) {
+      bool changed = layout.groups[value - 1] != boardLayout.groups[value - 1] ||
+                     layout.boundaries[value - 1] != boardLayout.boundaries[value - 1];
+      for (int k = 0; k < K; ++k) {
+        changed = changed || layout.links[k][value - 1] != boardLayout.links[k][value - 1];
+      }
+      if (changed) {
+        lastChangedValue = std::max(lastChangedValue, value);
+      }
+    }
+    boardLayout = layout;
+  }
+  void setRack(const std::vector<Tile>& rack) { setCounts(rack, rackCounts, numJokersInRack); }
+  void addRackTile(const Tile tile) {
+    if (tile.isJoker) {
+      numJokersInRack += 1;
+      lastChangedValue = N;
+    } else {
+      rackCounts.add(tile.color, tile.faceValue);
+      lastChangedValue = std::max(lastChangedValue, int(tile.faceValue));
+    }
+  }
+  // returns false if the tile is not in the rack
+  bool removeRackTile(const Tile tile) {
+    if (tile.isJoker ? numJokersInRack == 0 : rackCounts.get(tile.color, tile.faceValue) == 0) {
+      return false;
+    }
+    if (tile.isJoker) {
+      numJokersInRack -= 1;
+    } else {
+      rackCounts.remove(tile.color, tile.faceValue);
+    }
+    lastChangedValue = std::max(lastChangedValue, tile.isJoker ? N : tile.faceValue);
+    return true;
+  }
+
+  // Same as solve(board, rack) for the position kept by the solver
+  std::pair<std::vector<TileSet>, std::vector<Tile>> solve() {
+    NoStats stats;
+    return incrementalSolve(stats);
+  }
+  std::pair<std::vector<TileSet>, std::vector<Tile>> solve(SolveStats& stats) {
+    stats = {};
+    return incrementalSolve(stats);
+  }
+
+  // Positions can be stored as PositionRecords, which only hold the standard face values and
+  // colors with up to two copies of a tile
+  static constexpr bool RECORDS = N == PositionRecord::N && K == PositionRecord::K &&
+                                  M <= PositionRecord::MAX_COPIES &&
+                                  J <= PositionRecord::MAX_NUM_JOKERS;
+
+  // The position as a record, without an expected score
+  static PositionRecord toRecord(const std::vector<TileSet>& board, const std::vector<Tile>& rack)
+    requires RECORDS
+  {
+    const auto [table, hand, numJokersOnTable, numJokersInHand] =
+        getArraysFromTileSets(board, rack);
+    const LayoutT layout = getLayout(board);
+    PositionRecord record{};
+    for (int value = 1; value <= N; ++value) {
+      for (int k = 0; k < K; ++k) {
+        record.board[value - 1] |= table.get(k, value) << (2 * k);
+        record.rack[value - 1] |= hand.get(k, value) << (2 * k);
+        record.links[value - 1] |= layout.links[k][value - 1] << (2 * k);
+      }
+      if (value >= 2) {
+        record.boundaries[(value - 2) / 2] |= layout.boundaries[value - 1]
+                                              << PositionRecord::boundaryShift(value);
+      }
+      for (int i = 0; i < PositionRecord::MAX_NUM_GROUPS; ++i) {
+        record.groups[value - 1] |= layout.groups[value - 1][i] << (4 * i);
+      }
+    }
+    record.numJokersOnBoard = numJokersOnTable;
+    record.numJokersInRack = numJokersInHand;
+    record.expectedScore = PositionRecord::NO_SCORE;
+    return record;
+  }
+
+  // Same as solve(board, rack) for the position of the record, read without building its sets
+  std::pair<std::vector<TileSet>, std::vector<Tile>> solve(const PositionRecord& record)
+    requires RECORDS
+  {
+    LayoutT layout;
+    for (int value = 1; value <= N; ++value) {
+      for (int k = 0; k < K; ++k) {
+        layout.links[k][value - 1] = PositionRecord::count(record.links[value - 1], k);
+      }
+      layout.boundaries[value - 1] = value >= 2 ? record.boundaryColors(value) : 0;
+      for (int i = 0; i < PositionRecord::MAX_NUM_GROUPS; ++i) {
+        layout.groups[value - 1][i] = PositionRecord::groupColors(record.groups[value - 1], i);
+      }
+    }
+    NoStats stats;
+    return serialSolve(
+        layout,
+        [&] {
+          CountsT table{};
+          CountsT hand{};
+          for (int value = 1; value <= N; ++value) {
+            for (int k = 0; k < K; ++k) {
+              table.values[value - 1] |= PositionRecord::count(record.board[value - 1], k)
+                                         << (k * CountsT::BITS);
+              hand.values[value - 1] |= PositionRecord::count(record.rack[value - 1], k)
+                                        << (k * CountsT::BITS);
+            }
+          }
+          return std::tuple(table, hand, int(record.numJokersOnBoard),
+                            int(record.numJokersInRack));
+        },
+        stats);
+  }
+
+private:
+  // Stands in for SolveStats when the caller does not ask for them, nothing is counted
+  struct NoStats {};
+  template <typename Stats>
+  static constexpr bool COUNTING = !std::is_same_v<std::remove_cvref_t<Stats>, NoStats>;
+
+  static constexpr int EMPTY = -9999999;   // denotes that an entry in a table has not been computed
+  static constexpr int INVALID = -(1 << 29); // denotes an invalid configuration
+
+  static constexpr int MAX_NUM_JOKERS = J;
+  static constexpr int NUM_JOKER_COUNTS = MAX_NUM_JOKERS + 1; // jokers used go from 0 to J
+  static constexpr int MAX_NUM_GROUPS = (M * K + MAX_NUM_JOKERS) / 3;
+  static constexpr int MAX_GROUP_SIZE = std::min(K, 4); // the largest group TileSet::isGroup allows
+
+  static constexpr int8_t NO_CHOICE = -2; // denotes an unused joker in a ChoiceT
+
+  static_assert(
+      [] {
+        for (int value = 1; value <= N; ++value) {
+          if (Scoring::tile(value) < 0 || Scoring::joker(value) < 0) {
+            return false;
+          }
+        }
+        return true;
+      }(),
+      "scores must not be negative");
+
+  // an upper bound on the score of any play, every tile and every joker at its best value
+  static constexpr int64_t MAX_SCORE = [] {
+    int64_t score = 0;
+    int64_t joker = 0;
+    for (int value = 1; value <= N; ++value) {
+      score += int64_t(K) * M * Scoring::tile(value);
+      joker = std::max<int64_t>(joker, Scoring::joker(value));
+    }
+    return score + MAX_NUM_JOKERS * joker;
+  }();
+
+  // The search maximizes the score and then the similarity to the board, as the single number
+  // score * SIMILARITY_SCALE + similarity. Each tile played adds at most one to the similarity, as
+  // a kept link or boundary of a run or a tile in a kept group, see LayoutT.
+  static constexpr int SIMILARITY_SCALE = 2 * K * M * N + 1;
+  static_assert(MAX_SCORE * SIMILARITY_SCALE < -int64_t(INVALID), "scores must stay above INVALID");
+
+  // Number of tiles of each color and value, as 4-bit counts. The counts of a value are one
+  // integer, color k at bit 4 * k, so they are read together and whole positions are added a value
+  // at a time without carries. A count can go up to M + J, as the search adds the jokers to the
+  // tiles that they stand for.
+  struct CountsT {
+    static constexpr int BITS = 4;
+    static_assert(M + J < (1 << BITS), "the counts are stored in 4 bits");
+    using ValueCountsT = std::conditional_t<BITS * K <= 16, uint16_t, uint32_t>;
+
+    std::array<ValueCountsT, N> values{};
+
+    // the counts of the colors of the value
+    unsigned ofValue(const int value) const { return values[value - 1]; }
+    static int colorCount(const unsigned valueCounts, const int k) {
+      return (valueCounts >> (k * BITS)) & ((1 << BITS) - 1);
+    }
+    int get(const int k, const int value) const { return colorCount(ofValue(value), k); }
+
+    void add(const int k, const int value) { values[value - 1] += 1 << (k * BITS); }
+    void remove(const int k, const int value) { values[value - 1] -= 1 << (k * BITS); }
+    CountsT& operator+=(const CountsT& other) {
+      for (int i = 0; i < N; ++i) {
+        values[i] += other.values[i];
+      }
+      return *this;
+    }
+
+    // the largest value whose counts differ from those of other, 0 if none do
+    int lastDifferentValue(const CountsT& other) const {
+      int value = N;
+      while (value > 0 && values[value - 1] == other.values[value - 1]) {
+        value -= 1;
+      }
+      return value;
+    }
+  };
+
+  // The lengths of the runs of a single color, sorted. A length of 3 stands for every run that
+  // already has three or more tiles.
+  using RunT = std::array<int, M>;
+  // The runs of every color, as indices of i2r. This is the state that the search keeps for the
+  // previous values, see StateT.
+  using RunsT = std::array<uint8_t, K>;
+
+  // number of canonical runs of a single color, 4 choose M with replacement
+  static constexpr int NUM_RUNS = (M + 1) * (M + 2) * (M + 3) / 6;
+
+  // number of canonical run states for a single value
+  static constexpr int WIDTH = [] {
+    int width = 1;
+    for (int k = 0; k < K; ++k) {
+      width *= NUM_RUNS;
+    }
+    return width;
+  }();
+
+  // A run state packed into one number, the search passes states around and indexes the table
+  // with them. The digits in base NUM_RUNS are the runs of the colors, color 0 first, so the state
+  // where no runs have been started is NO_RUNS.
+  static constexpr bool SMALL_STATES = WIDTH <= (1 << 16);
+  using StateT = std::conditional_t<SMALL_STATES, uint16_t, uint32_t>;
+  static constexpr StateT NO_RUNS = 0;
+
+  // stateRuns[s] is the runs of the state s, only kept when there are few states
+  static constexpr auto stateRuns = [] {
+    std::array<RunsT, SMALL_STATES ? WIDTH : 1> runs{};
+    for (int state = 0; SMALL_STATES && state < WIDTH; ++state) {
+      for (int k = K - 1, rest = state; k >= 0; --k) {
+        runs[state][k] = rest % NUM_RUNS;
+        rest /= NUM_RUNS;
+      }
+    }
+    return runs;
+  }();
+
+  // every canonical run of a single color in lexicographic order (index 2 runs)
+  static constexpr std::array<RunT, NUM_RUNS> i2r = [] {
+    std::array<RunT, NUM_RUNS> runs{};
+    RunT run{};
+    for (int r = 0; r < NUM_RUNS; ++r) {
+      runs[r] = run;
+      int i = M - 1;
+      while (i > 0 && run[i] == 3) {
+        i -= 1;
+      }
+      run[i] += 1;
+      for (int j = i + 1; j < M; ++j) {
+        run[j] = run[i];
+      }
+    }
+    return runs;
+  }();
+
+  // runIndices[c] is the index of the sorted run whose lengths are the base 4 digits of c
+  static constexpr auto runIndices = [] {
+    std::array<int8_t, 1 << (2 * M)> indices{};
+    for (int r = 0; r < NUM_RUNS; ++r) {
+      int code = 0;
+      for (int i = M - 1; i >= 0; --i) {
+        code = code * 4 + i2r[r][i];
+      }
+      indices[code] = r;
+    }
+    return indices;
+  }();
+
+  // One way to play tiles of the current value of a single color into its runs.
+  // The score is completed * getScoreForExtension(2, value) + extended * getScoreForExtension(3, value)
+  struct RunTransitionT {
+    int8_t next;      // r2i of the runs after the extension
+    uint8_t kind;     // which runs were extended, bit i is set if run i received a tile
+    int8_t numInRun;  // number of tiles played into runs
+    int8_t completed; // number of runs that reach three tiles
+    int8_t extended;  // number of runs of three or more tiles that get longer
+    int8_t linked;    // number of runs that already had tiles and get longer
+    int8_t restarted; // 1 if a run ends at the previous value and a new run starts
+  };
+  struct RunTransitionsT {
+    int8_t count = 0;
+    std::array<RunTransitionT, (1 << M)> transitions{};
+  };
+
+  // runTransitions[r][min(M, number of tiles of the current value)][start][boundary] lists every
+  // way to play the tiles of one color into the runs i2r[r], in the order that the search tries
+  // them. start is the number of new runs that the tiles of the next two values allow, and boundary
+  // is 1 if the board ends a run of the color at the previous value and starts one at this value.
+  static constexpr auto runTransitions = [] {
+    std::array<std::array<std::array<std::array<RunTransitionsT, 2>, M + 1>, M + 1>, NUM_RUNS>
+        table{};
+    for (int r = 0; r < NUM_RUNS; ++r) {
+      const RunT& run = i2r[r];
+      for (int numTiles = 0; numTiles <= M; ++numTiles) {
+        for (int start = 0; start <= M; ++start) {
+          for (int kind = 0; kind < (1 << M); ++kind) {
+            RunT next{};
+            int numInRun = 0;
+            int numStarted = 0;
+            int completed = 0;
+            int extended = 0;
+            bool valid = true;
+            bool endsStartedRun = false;
+            for (int i = 0; i < M; ++i) {
+              if ((kind >> i) & 1) {
+                next[i] = std::min(3, run[i] + 1);
+                numInRun += 1;
+                numStarted += int(run[i] == 0);
+                completed += int(run[i] == 2);
+                extended += int(run[i] == 3);
+                // Runs of the same length are interchangeable, only extend the first of them.
+                valid = valid && !(i > 0 && run[i - 1] == run[i] && !((kind >> (i - 1)) & 1));
+              } else {
+                // A run with one or two tiles must be extended. Ending it would discard its tiles,
+                // which is never better than not starting it, and whether the discard would violate
+                // the table constraint depends on how the state was reached. Not allowing it keeps
+                // the score of a state a function of the state alone.
+                valid = valid && (run[i] == 0 || run[i] == 3);
+                endsStartedRun = endsStartedRun || run[i] != 0;
+              }
+            }
+            // Do not start runs if we do not have enough time (or enough tiles) to finish them.
+            // NOTE there is an interaction with jokers and implicitly ending runs at the last value?
+            valid = valid && numInRun <= numTiles && numStarted <= start;
+            // Do not start a run while ending a run that is already started, just extend the
+            // started run instead, which scores the same. This makes my tests a bit faster. Where
+            // the board has a run boundary the board's own split is allowed, so that it can be
+            // kept.
+            const bool restarted = numStarted > 0 && endsStartedRun;
+            if (!valid) {
+              continue;
+            }
+            std::sort(next.begin(), next.end());
+            int code = 0;
+            for (int i = M - 1; i >= 0; --i) {
+              code = code * 4 + next[i];
+            }
+            const RunTransitionT transition = {runIndices[code], uint8_t(kind), int8_t(numInRun),
+                                               int8_t(completed), int8_t(extended),
+                                               int8_t(numInRun - numStarted), int8_t(restarted)};
+            for (int boundary = int(restarted); boundary < 2; ++boundary) {
+              RunTransitionsT& result = table[r][numTiles][start][boundary];
+              result.transitions[result.count] = transition;
+              result.count += 1;
+            }
+          }
+        }
+      }
+    }
+    return table;
+  }();
+
+  // The best way to play tiles of a single value into groups
+  struct GroupPackingT {
+    int8_t totalNumInGroups = 0;
+    std::array<int8_t, K> numInGroupsBySuit{};
+    // a group is represented by the mask of its colors, unused groups are 0
+    std::array<uint8_t, MAX_NUM_GROUPS> groups{};
+  };
+
+  // A color can not have more tiles in groups than there are groups
+  static constexpr int GROUP_COUNTS = MAX_NUM_GROUPS + 1;
+  static constexpr int NUM_GROUP_PACKINGS = [] {
+    int size = 1;
+    for (int k = 0; k < K; ++k) {
+      size *= GROUP_COUNTS;
+    }
+    return size;
+  }();
+
+  // groupPackings[(c0 * GROUP_COUNTS + c1) * GROUP_COUNTS + ...] is the best way to play groups
+  // when there are ck tiles of color k. Each entry takes the best group to play first on top of
+  // the entry for the tiles that are left, which always has a smaller index. Small tables are
+  // computed at compile time, the compiler gives up on the larger ones and they are computed when
+  // the program starts.
+  static inline const auto groupPackings = [] {
+    // every group with the largest first, and how much taking it lowers the index
+    struct GroupT {
+      uint8_t colors;
+      int size;
+      int offset;
+    };
+    std::array<GroupT, (1 << K)> groups{};
+    int numGroups = 0;
+    for (int size = MAX_GROUP_SIZE; size >= 3; --size) {
+      for (int colors = 0; colors < (1 << K); ++colors) {
+        if (std::popcount(unsigned(colors)) == size) {
+          int offset = 0;
+          for (int k = 0; k < K; ++k) {
+            offset = offset * GROUP_COUNTS + ((colors >> k) & 1);
+          }
+          groups[numGroups] = {uint8_t(colors), size, offset};
+          numGroups += 1;
+        }
+      }
+    }
+
+    std::array<GroupPackingT, NUM_GROUP_PACKINGS> table{};
+    for (int index = 0; index < NUM_GROUP_PACKINGS; ++index) {
+      std::array<int, K> tileCounts{};
+      for (int k = K - 1, rest = index; k >= 0; --k, rest /= GROUP_COUNTS) {
+        tileCounts[k] = rest % GROUP_COUNTS;
+      }
+      int best = -1;
+      for (int g = 0; g < numGroups; ++g) {
+        bool available = true;
+        for (int k = 0; k < K; ++k) {
+          available = available && (tileCounts[k] > 0 || !((groups[g].colors >> k) & 1));
+        }
+        if (!available) {
+          continue;
+        }
+        const int total = table[index - groups[g].offset].totalNumInGroups + groups[g].size;
+        if (best < 0 || total > table[index].totalNumInGroups) {
+          best = g;
+          table[index].totalNumInGroups = total;
+        }
+      }
+      if (best < 0) {
+        continue;
+      }
+      GroupPackingT& packing = table[index];
+      packing = table[index - groups[best].offset];
+      packing.totalNumInGroups += groups[best].size;
+      for (int i = MAX_NUM_GROUPS - 1; i > 0; --i) {
+        packing.groups[i] = packing.groups[i - 1];
+      }
+      packing.groups[0] = groups[best].colors;
+      for (int k = 0; k < K; ++k) {
+        packing.numInGroupsBySuit[k] += (groups[best].colors >> k) & 1;
+      }
+    }
+    return table;
+  }();
+
+  // The best choice found at a state. Following these from the first state rebuilds the best
+  // configuration, the next state is implied by the extensions and the number of jokers.
+  struct ChoiceT {
+    std::array<uint8_t, K> extensions;            // which runs were extended per suit
+    std::array<int8_t, MAX_NUM_JOKERS> jokers;    // joker color assignments
+    std::array<uint8_t, MAX_NUM_GROUPS> groups;   // group representations
+  };
+
+  // The sets on the board that the search tries to keep. A link is a pair of neighbouring tiles in
+  // a run, it is kept if a run is extended from one to the other. A boundary is a run that ends
+  // right before another run of the same color starts, it is kept if a run is ended and another
+  // started there, instead of the two being joined by a link the board does not have. A group is
+  // kept if a group with the same colors is played. Groups with jokers are never kept since their
+  // colors are not known.
+  struct LayoutT {
+    // links[k][value - 1] counts the runs on the board that link the tiles of color k and values
+    // value - 1 and value
+    std::array<std::array<int8_t, N>, K> links{};
+    // bit k of boundaries[value - 1] is set if a board run of color k ends at value - 1 and another
+    // starts at value
+    std::array<uint8_t, N> boundaries{};
+    // groups[value - 1] holds the colors of the groups of the value on the board, like
+    // ChoiceT::groups
+    std::array<std::array<uint8_t, MAX_NUM_GROUPS>, N> groups{};
+
+    bool operator==(const LayoutT&) const = default;
+  };
+
+  // one of the best ways to play from a state, see solveTopK
+  struct RankedT {
+    int score;
+    ChoiceT choice;
+    int next; // which of the best ways to play from the next state follows
+  };
+
+  // The sets that a choice plays, as getTileSetsFromChoices builds them. A joker stands for the
+  // first tile of its color in the groups of the value, or else in the runs. So the color of a joker
+  // in a group does not show in the sets, only the colors of the other tiles of the group do.
+  struct SetsOfChoiceT {
+    std::array<uint8_t, K> extensions;
+    std::array<int8_t, MAX_NUM_JOKERS> runJokers;  // the colors of the jokers in runs, sorted
+    std::array<uint16_t, MAX_NUM_GROUPS> groups;    // colors | number of jokers << 8, sorted
+
+    bool operator==(const SetsOfChoiceT&) const = default;
+  };
+
+  // The best ways to play from the states searched by _topScores. ranges maps a state to the range
+  // of ranked that holds its best ways to play, best first.
+  struct TopKMemo {
+    int k;
+    LayoutT layout;
+    std::vector<RankedT> ranked;
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> ranges;
+    std::vector<SetsOfChoiceT> kept; // used by _topScores
+
+    // ranked[0] is the only way to play from the end of the search
+    TopKMemo(const int k, const LayoutT& layout)
+        : k(k), layout(layout), ranked{{0, ChoiceT{}, 0}} {}
+
+    static uint64_t key(const int value, const StateT state, const int numJokersUsed) {
+      return (uint64_t(value - 1) * WIDTH + state) * NUM_JOKER_COUNTS + numJokersUsed;
+    }
+  };
+
+  // one way to play the tiles of the first value, searched as a task by parallelMaxScore
+  struct BranchT {
+    StateT state;
+    int numJokersUsed;
+    int score; // what the tiles of the first value contribute
+    ChoiceT choice;
+    int result; // score plus the best score of the rest of the search
+  };
+
+  // aligned so that parallel searches can update an entry with a single atomic operation
+  struct alignas(8) ScoreEntry {
+    uint32_t generation = 0; // entry is EMPTY unless this matches the generation of its value
+    int score = EMPTY;
+  };
+
+  // Tables that outlive a single solve. The entries of a value are invalidated between solves by
+  // bumping the generation of the value instead of refilling them, so a warm solve touches only
+  // the entries it visits.
+  struct DenseContext {
+    std::array<std::array<std::array<ScoreEntry, NUM_JOKER_COUNTS>, WIDTH>, N> scores;
+    std::array<uint32_t, N> generations{};
+    uint32_t lastGeneration = 0;
+
+    // choices[value - 1][index][numJokersUsed] is only meaningful if the matching score entry is
+    // valid
+    std::array<std::array<std::array<ChoiceT, NUM_JOKER_COUNTS>, WIDTH>, N> choices;
+
+    // used by parallelMaxScore
+    std::vector<BranchT> branches;
+
+    // the board of the position being solved
+    LayoutT layout;
+
+    ScoreEntry& score(const int value, const int index, const int numJokersUsed) {
+      return scores[value - 1][index][numJokersUsed];
+    }
+    ChoiceT& choice(const int value, const int index, const int numJokersUsed) {
+      return choices[value - 1][index][numJokersUsed];
+    }
+
+    uint32_t generation(const int value) const { return generations[value - 1]; }
+
+    // Invalidates the entries of the values up to lastValue. Returns the last value that was
+    // invalidated, which is N if the generations wrapped around and every entry was cleared.
+    int invalidate(int lastValue) {
+      lastGeneration += 1;
+      if (lastGeneration == 0) { // wrapped around, stale entries could match again
+        for (auto& layer : scores) {
+          for (auto& entries : layer) {
+            entries.fill({});
+          }
+        }
+        lastGeneration = 1;
+        lastValue = N;
+      }
+      for (int value = 1; value <= lastValue; ++value) {
+        generations[value - 1] = lastGeneration;
+      }
+      return lastValue;
+    }
+  };
+
+  // Same interface as DenseContext, but only the entries of the states that the search reaches
+  // are stored, in an open addressing hash table per value. A solve of the standard game usually
+  // reaches a few hundred states, so the tables take tens of kilobytes where the dense table takes
+  // megabytes. Only used by the serial top down engine, claiming a slot can move the other slots of
+  // its value, so a reference to an entry is only valid until the next entry of its value is used.
+  struct CompactContext {
+    // index * NUM_JOKER_COUNTS + numJokersUsed, 64 bits for the rules whose keys do not fit in 32
+    using KeyT = std::conditional_t<uint64_t(WIDTH) * NUM_JOKER_COUNTS <= UINT32_MAX, uint32_t,
+                                    uint64_t>;
+    struct SlotT {
+      KeyT key = 0;
+      uint32_t generation = 0; // the slot is free unless this matches the generation of its value
+      ScoreEntry entry;
+    };
+    struct LayerT {
+      std::vector<SlotT> slots = std::vector<SlotT>(64); // the size is a power of two
+      std::vector<ChoiceT> choices = std::vector<ChoiceT>(64);
+      size_t size = 0;
+      uint32_t generation = 1;
+    };
+    std::array<LayerT, N> layers;
+    uint32_t lastGeneration = 1;
+
+    // the board of the position being solved
+    LayoutT layout;
+
+    ScoreEntry& score(const int value, const int index, const int numJokersUsed) {
+      LayerT& layer = layers[value - 1];
+      return layer.slots[claim(layer, index, numJokersUsed)].entry;
+    }
+    ChoiceT& choice(const int value, const int index, const int numJokersUsed) {
+      LayerT& layer = layers[value - 1];
+      return layer.choices[claim(layer, index, numJokersUsed)];
+    }
+
+    uint32_t generation(const int value) const { return layers[value - 1].generation; }
+
+    // Frees the slots of the values up to lastValue, returns lastValue like DenseContext
+    int invalidate(int lastValue) {
+      lastGeneration += 1;
+      if (lastGeneration == 0) { // wrapped around, stale slots could match again
+        for (LayerT& layer : layers) {
+          std::fill(layer.slots.begin(), layer.slots.end(), SlotT{});
+        }
+        lastGeneration = 1;
+        lastValue = N;
+      }
+      for (int value = 1; value <= lastValue; ++value) {
+        layers[value - 1].generation = lastGeneration;
+        layers[value - 1].size = 0;
+      }
+      return lastValue;
+    }
+
+    // The first slot of the key or the free slot that ends its probe sequence, the slots of a value
+    // are freed all at once so the probe sequences never have holes
+    static size_t find(const LayerT& layer, const KeyT key) {
+      const size_t mask = layer.slots.size() - 1;
+      size_t i;
+      if constexpr (sizeof(KeyT) == 4) {
+        i = (key * 0x9e3779b9u) >> 7 & mask;
+      } else {
+        i = (key * 0x9e3779b97f4a7c15u) >> 32 & mask;
+      }
+      while (layer.slots[i].generation == layer.generation && layer.slots[i].key != key) {
+        i = (i + 1) & mask;
+      }
+      return i;
+    }
+
+    // Returns the slot of the entry, claiming a free slot if the entry is new. The table doubles
+    // when it gets half full.
+    static size_t claim(LayerT& layer, const int index, const int numJokersUsed) {
+      const KeyT key = KeyT(index) * NUM_JOKER_COUNTS + numJokersUsed;
+      size_t i = find(layer, key);
+      if (layer.slots[i].generation == layer.generation) {
+        return i;
+      }
+      if (2 * (layer.size + 1) > layer.slots.size()) {
+        LayerT grown{std::vector<SlotT>(2 * layer.slots.size()),
+                     std::vector<ChoiceT>(2 * layer.slots.size()), layer.size, layer.generation};
+        for (size_t j = 0; j < layer.slots.size(); ++j) {
+          if (layer.slots[j].generation == layer.generation) {
+            const size_t g = find(grown, layer.slots[j].key);
+            grown.slots[g] = layer.slots[j];
+            grown.choices[g] = layer.choices[j];
+          }
+        }
+        layer = std::move(grown);
+        i = find(layer, key);
+      }
+      layer.slots[i] = {key, layer.generation, {}};
+      layer.size += 1;
+      return i;
+    }
+  };
+
+  // the dense table of the standard game takes about 7MB
+  static constexpr bool DENSE = int64_t(N) * WIDTH * NUM_JOKER_COUNTS <= (1 << 21);
+
+  // convert the lengths of the runs of a single color into an index (runs 2 index)
+  static int r2i(RunT run) {
+    std::sort(run.begin(), run.end());
+    int code = 0;
+    for (int i = M - 1; i >= 0; --i) {
+      code = code * 4 + run[i];
+    }
+    return runIndices[code];
+  }
+
+  // compute the score we get for adding a tile of value = value to a run of length a
+  static constexpr int getScoreForExtension(int a, int value) {
+    if (a == 2) {
+      return Scoring::tile(value - 2) + Scoring::tile(value - 1) + Scoring::tile(value);
+    } else if (a == 3) {
+      return Scoring::tile(value);
+    }
+    return 0;
+  }
+
+  // compute cartesian product of the ways of colors k and up, and zip. Returns true if visit
+  // returned true to stop.
+  template <int k>
+  static bool combineRunTransitions(const std::array<const RunTransitionsT*, K>& colorTransitions,
+                                    const int completeScore, const int extendScore,
+                                    const std::array<int, K>& links, const int newState,
+                                    std::array<int, K>& numInRunsBySuit,
+                                    std::array<uint8_t, K>& kinds, const int runScores,
+                                    auto&& visit) {
+    if constexpr (k == K) {
+      return visit(StateT(newState), runScores, numInRunsBySuit, kinds);
+    } else {
+      const RunTransitionsT& transitions = *colorTransitions[k];
+      for (int i = 0; i < transitions.count; ++i) {
+        const RunTransitionT& t = transitions.transitions[i];
+        numInRunsBySuit[k] = t.numInRun;
+        kinds[k] = t.kind;
+        if (combineRunTransitions<k + 1>(colorTransitions, completeScore, extendScore, links,
+                                         newState * NUM_RUNS + t.next, numInRunsBySuit, kinds,
+                                         runScores + t.completed * completeScore +
+                                             t.extended * extendScore +
+                                             std::min<int>(links[k], t.linked) + t.restarted,
+                                         visit)) {
+          return true;
+        }
+      }
+      return false;
+    }
+  }
+
+  // Calls visit(newState, runScores, numInRunsBySuit, kinds) for every way that we can play tiles
+  // of the current value into runs. The ways of each color come from runTransitions and are
+  // combined here, so nothing is allocated. runScores already includes the links and boundaries of
+  // the layout that are kept, see SIMILARITY_SCALE. visit returns true to stop, and then so does
+  // this.
+  static bool forEachRunExtension(const int value, const StateT state, const CountsT& tiles,
+                                  const LayoutT& layout, auto&& visit) {
+    const RunsT runs = runsFromIndex(state);
+    std::array<const RunTransitionsT*, K> colorTransitions;
+    std::array<int, K> links;
+    const unsigned counts = tiles.ofValue(value);
+    const unsigned nextCounts = value < N - 1 ? tiles.ofValue(value + 1) : 0;
+    const unsigned afterNextCounts = value < N - 1 ? tiles.ofValue(value + 2) : 0;
+    for (int k = 0; k < K; ++k) {
+      links[k] = layout.links[k][value - 1];
+      const int numTiles = std::min(M, CountsT::colorCount(counts, k));
+      const int start = std::min({M, CountsT::colorCount(nextCounts, k),
+                                  CountsT::colorCount(afterNextCounts, k)});
+      const int boundary = (layout.boundaries[value - 1] >> k) & 1;
+      colorTransitions[k] = &runTransitions[runs[k]][numTiles][start][boundary];
+    }
+    std::array<int, K> numInRunsBySuit;
+    std::array<uint8_t, K> kinds;
+    return combineRunTransitions<0>(colorTransitions,
+                                    getScoreForExtension(2, value) * SIMILARITY_SCALE,
+                                    getScoreForExtension(3, value) * SIMILARITY_SCALE, links, 0,
+                                    numInRunsBySuit, kinds, 0, visit);
+  }
+
+  // returns the best way to play the tiles of the current value that are not played into runs,
+  // counts are the tiles of the value, see CountsT::ofValue
+  static const GroupPackingT& totalGroupSize(const unsigned counts,
+                                             const std::array<int, K>& numInRunsBySuit) {
+    int index = 0;
+    for (int k = 0; k < K; ++k) {
+      // A color can not have more tiles in groups than there are groups, so discard the rest.
+      // If discarding is a violation of the table constraint, then we catch that later.
+      index = index * GROUP_COUNTS +
+              std::min(MAX_NUM_GROUPS, CountsT::colorCount(counts, k) - numInRunsBySuit[k]);
+    }
+    return groupPackings[index];
+  }
+
+  static bool tableConstraint(const unsigned counts, const std::array<int, K>& numInRunsBySuit,
+                              const std::array<int8_t, K>& numInGroupsBySuit) {
+    for (int k = 0; k < K; ++k) {
+      if (numInRunsBySuit[k] + numInGroupsBySuit[k] < CountsT::colorCount(counts, k)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // the number of tiles in groups that are also groups of the board, each board group is only
+  // matched once
+  static int keptGroupTiles(const std::array<uint8_t, MAX_NUM_GROUPS>& groups,
+                            const std::array<uint8_t, MAX_NUM_GROUPS>& boardGroups) {
+    int kept = 0;
+    unsigned matched = 0;
+    for (int i = 0; i < MAX_NUM_GROUPS && groups[i] != 0 && boardGroups[0] != 0; ++i) {
+      for (int j = 0; j < MAX_NUM_GROUPS && boardGroups[j] != 0; ++j) {
+        if (boardGroups[j] == groups[i] && !((matched >> j) & 1)) {
+          matched |= 1u << j;
+          kept += std::popcount(unsigned(groups[i]));
+          break;
+        }
+      }
+    }
+    return kept;
+  }
+
+  static StateT stateIndex(const RunsT& runs) {
+    int index = 0;
+    for (int k = 0; k < K; ++k) {
+      index = index * NUM_RUNS + runs[k];
+    }
+    return index;
+  }
+  // the inverse of stateIndex
+  static RunsT runsFromIndex(StateT state) {
+    if constexpr (SMALL_STATES) {
+      return stateRuns[state];
+    } else {
+      RunsT runs;
+      for (int k = K - 1; k >= 0; --k) {
+        runs[k] = state % NUM_RUNS;
+        state /= NUM_RUNS;
+      }
+      return runs;
+    }
+  }
+
+  // Calls visit(newState, newNumJokersUsed, score, choice) for every way to play the tiles of the
+  // current value that satisfies the table constraint, where score is what the played tiles
+  // contribute. While visit runs, tiles and table include the jokers assigned by the choice. A visit
+  // that returns a bool stops the enumeration by returning true.
+  static void forEachChoice(const int value, const StateT state, const int numJokersUsed,
+                            CountsT& tiles, CountsT& table, const LayoutT& layout,
+                            const int totalNumJokers, auto& stats, auto&& visit) {
+    [[maybe_unused]] int64_t fanOut = 0;
+    const int numJokersAvailable = totalNumJokers - numJokersUsed;
+    bool stopped = false;
+    for (int numJokers = 0; numJokers <= numJokersAvailable && !stopped; ++numJokers) {
+      // choose a color assignment for the jokers, the colors never decrease so that every
+      // assignment is tried once
+      std::array<int, MAX_NUM_JOKERS> jokers{};
+      while (true) {
+        // if we decide to discard a tile when making runs or forming groups then we assume it is
+        // not a joker. if it must be a joker (there are no other regular tiles) then the run
+        // extension / group is not a valid state and discarding the tile is a violation of the
+        // table constraint.
+        //
+        // this modification of table ensures that it would be a violation of the table constraint
+        // to not use the numJokers jokers.
+        for (int i = 0; i < numJokers; ++i) {
+          table.add(jokers[i], value);
+          tiles.add(jokers[i], value);
+        }
+        const unsigned counts = tiles.ofValue(value);
+        const unsigned tableCounts = table.ofValue(value);
+        stopped = forEachRunExtension(value, state, tiles, layout,
+                                      [&](const StateT newState, const int runScores,
+                                          const std::array<int, K>& numInRunsBySuit,
+                                          const std::array<uint8_t, K>& kinds) {
+          if constexpr (COUNTING<decltype(stats)>) {
+            fanOut += 1;
+            stats.groupLookups += 1;
+          }
+          // play remaining tiles into groups
+          const GroupPackingT& packing = totalGroupSize(counts, numInRunsBySuit);
+
+          // Check that the number of tiles (of current value) in the chosen run extension and
+          // groups is enough
+          if (!tableConstraint(tableCounts, numInRunsBySuit, packing.numInGroupsBySuit)) {
+            if constexpr (COUNTING<decltype(stats)>) {
+              stats.tableConstraintRejections += 1;
+            }
+            return false;
+          }
+
+          // Because we do not discard jokers, we can add the value for them right now. They are
+          // also counted as tiles by the runs and groups.
+          const int jokerScores = numJokers * (Scoring::joker(value) - Scoring::tile(value));
+          const int groupScores = packing.totalNumInGroups * Scoring::tile(value);
+
+          ChoiceT choice;
+          choice.extensions = kinds;
+          for (int i = 0; i < MAX_NUM_JOKERS; ++i) {
+            choice.jokers[i] = i < numJokers ? jokers[i] : NO_CHOICE;
+          }
+          choice.groups = packing.groups;
+
+          const int score = (groupScores + jokerScores) * SIMILARITY_SCALE + runScores +
+                            keptGroupTiles(packing.groups, layout.groups[value - 1]);
+          if constexpr (std::is_same_v<decltype(visit(newState, 0, 0, choice)), bool>) {
+            return visit(newState, numJokersUsed + numJokers, score, choice);
+          } else {
+            visit(newState, numJokersUsed + numJokers, score, choice);
+            return false;
+          }
+        });
+        for (int i = 0; i < numJokers; ++i) {
+          table.remove(jokers[i], value);
+          tiles.remove(jokers[i], value);
+        }
+
+        // next assignment
+        int i = numJokers - 1;
+        while (i >= 0 && jokers[i] == K - 1) {
+          i -= 1;
+        }
+        if (i < 0 || stopped) {
+          break;
+        }
+        jokers[i] += 1;
+        for (int j = i + 1; j < numJokers; ++j) {
+          jokers[j] = jokers[i];
+        }
+      }
+    }
+    if constexpr (COUNTING<decltype(stats)>) {
+      stats.fanOut += fanOut;
+      stats.maxFanOut = std::max(stats.maxFanOut, fanOut);
+    }
+  }
+
+  // When Parallel is set other workers fill the same score table at the same time. An entry is
+  // claimed by storing the generation of its value with an EMPTY score, and only the worker that claimed
+  // it writes its choice and publishes its score. A worker that finds a pending entry computes the
+  // score itself instead of waiting, which is safe because the score of a state only depends on the
+  // state.
+  template <bool Parallel>
+  static int _maxScore(const int value,                //
+                       const StateT state,             //
+                       const int numJokersUsed,        //
+                       CountsT& tiles,                 //
+                       CountsT& table,                 //
+                       auto& context,                  //
+                       auto& stats,                    //
+                       const int minNumJokersRequired, //
+                       const int totalNumJokers) {     //
+    if (value > N) {
+      if (numJokersUsed < minNumJokersRequired) {
+        return INVALID;
+      }
+      return 0;
+    }
+
+    ScoreEntry& entry = context.score(value, state, numJokersUsed);
+    const uint32_t generation = context.generation(value);
+    bool claimed = true;
+    if constexpr (Parallel) {
+      std::atomic_ref<ScoreEntry> cell(entry);
+      ScoreEntry seen = cell.load(std::memory_order_acquire);
+      if (seen.generation == generation && seen.score != EMPTY) {
+        return seen.score;
+      }
+      claimed = seen.generation != generation &&
+                cell.compare_exchange_strong(seen, ScoreEntry{generation, EMPTY},
+                                             std::memory_order_acquire);
+    } else if (entry.generation == generation) {
+      if constexpr (COUNTING<decltype(stats)>) {
+        stats.memoHits += 1;
+      }
+      return entry.score;
+    }
+    if constexpr (COUNTING<decltype(stats)>) {
+      stats.statesExpanded += 1;
+    }
+
+    int answer = INVALID;
+    ChoiceT best;
+    forEachChoice(value, state, numJokersUsed, tiles, table, context.layout, totalNumJokers, stats,
+                  [&](const StateT newState, const int newNumJokersUsed, const int score,
+                      const ChoiceT& choice) {
+                    const int result =
+                        score + _maxScore<Parallel>(value + 1, newState, newNumJokersUsed, tiles,
+                                                    table, context, stats, minNumJokersRequired,
+                                                    totalNumJokers);
+                    if (result > answer) {
+                      answer = result;
+                      best = choice;
+                    }
+                  });
+
+    // The current state is invalid if we are at a node where there is no way to extend the runs.
+    // So the return value should be s.t. result can not contribute to the max.
+    if (answer < 0) {
+      answer = INVALID;
+    }
+
+    // Memoize
+    if (claimed) {
+      if (answer != INVALID) {
+        context.choice(value, state, numJokersUsed) = best;
+      }
+      if constexpr (Parallel) {
+        std::atomic_ref<ScoreEntry>(entry).store({generation, answer}, std::memory_order_release);
+      } else {
+        entry = {generation, answer};
+      }
+    }
+    return answer;
+  }
+
+  // Same search as _maxScore, but keeps the k best ways to play from each state. The candidates of
+  // a state are every way to play its value followed by one of the best ways to play from the next
+  // state, and ties keep the order of the search so that the best one is the one _maxScore finds.
+  // Returns the range of memo.ranked with the best ways to play from the state.
+  static std::pair<uint32_t, uint32_t> _topScores(const int value,                //
+                                                  const StateT state,             //
+                                                  const int numJokersUsed,        //
+                                                  CountsT& tiles,                 //
+                                                  CountsT& table,                 //
+                                                  TopKMemo& memo,                 //
+                                                  const int minNumJokersRequired, //
+                                                  const int totalNumJokers) {     //
+    if (value > N) {
+      if (numJokersUsed < minNumJokersRequired) {
+        return {0, 0};
+      }
+      return {0, 1};
+    }
+
+    const uint64_t key = TopKMemo::key(value, state, numJokersUsed);
+    if (const auto it = memo.ranges.find(key); it != memo.ranges.end()) {
+      return it->second;
+    }
+
+    std::vector<RankedT> candidates;
+    NoStats stats;
+    forEachChoice(value, state, numJokersUsed, tiles, table, memo.layout, totalNumJokers, stats,
+                  [&](const StateT newState, const int newNumJokersUsed, const int score,
+                      const ChoiceT& choice) {
+                    const auto [begin, end] =
+                        _topScores(value + 1, newState, newNumJokersUsed, tiles, table, memo,
+                                   minNumJokersRequired, totalNumJokers);
+                    for (uint32_t i = begin; i < end; ++i) {
+                      const int result = score + memo.ranked[i].score;
+                      if (result >= 0) {
+                        candidates.push_back({result, choice, int(i - begin)});
+                      }
+                    }
+                  });
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const RankedT& a, const RankedT& b) { return a.score > b.score; });
+
+    // Ways to play that give the same sets are only kept once, the best of them. The ways to play
+    // from the next state are already distinct, so two candidates give the same sets if their
+    // choices do and they follow the same way to play from the next state.
+    const uint32_t begin = memo.ranked.size();
+    std::vector<SetsOfChoiceT>& kept = memo.kept;
+    kept.clear();
+    for (size_t i = 0; i < candidates.size() && kept.size() < size_t(memo.k); ++i) {
+      const SetsOfChoiceT sets = setsOfChoice(candidates[i].choice);
+      bool seen = false;
+      for (size_t j = 0; j < kept.size() && !seen; ++j) {
+        seen = kept[j] == sets && memo.ranked[begin + j].next == candidates[i].next;
+      }
+      if (!seen) {
+        kept.push_back(sets);
+        memo.ranked.push_back(candidates[i]);
+      }
+    }
+    return memo.ranges[key] = {begin, memo.ranked.size()};
+  }
+
+  // see SetsOfChoiceT
+  static SetsOfChoiceT setsOfChoice(const ChoiceT& choice) {
+    SetsOfChoiceT sets;
+    sets.extensions = choice.extensions;
+    sets.runJokers.fill(NO_CHOICE);
+    for (int i = 0; i < MAX_NUM_GROUPS; ++i) {
+      sets.groups[i] = choice.groups[i];
+    }
+    int numRunJokers = 0;
+    for (const int8_t color : choice.jokers) {
+      if (color == NO_CHOICE) {
+        continue;
+      }
+      int i = 0;
+      while (i < MAX_NUM_GROUPS && !((sets.groups[i] >> color) & 1)) {
+        i += 1;
+      }
+      if (i < MAX_NUM_GROUPS) {
+        sets.groups[i] += (1 << 8) - (1 << color);
+      } else {
+        sets.runJokers[numRunJokers++] = color;
+      }
+    }
+    std::sort(sets.runJokers.begin(), sets.runJokers.begin() + numRunJokers);
+    std::sort(sets.groups.begin(), sets.groups.end());
+    return sets;
+  }
+
+  // _maxScore temporarily adds jokers to the tiles and the table while it recurses, so the engines
+  // work on their own copies
+  static CountsT getTiles(const CountsT& table, const CountsT& hand) {
+    CountsT tiles = table;
+    tiles += hand;
+    return tiles;
+  }
+
+  // The entries of a value only depend on the tiles of that value and the values above it, and on
+  // the number of jokers. The entries of the values above lastValue are kept from the last solve.
+  static int maxScore(auto& context, const CountsT& table, const CountsT& hand,
+                      const int numJokersOnTable, const int numJokersInHand, const int lastValue,
+                      auto& stats) {
+    const int value = 1;
+    context.invalidate(lastValue);
+    CountsT tiles = getTiles(table, hand);
+    CountsT constraint = table;
+    const int numJokersUsed = 0;
+    const int minNumJokersRequired = numJokersOnTable;
+    const int totalNumJokers = numJokersOnTable + numJokersInHand;
+
+    const int result = _maxScore<false>(value, NO_RUNS, numJokersUsed, tiles, constraint, context,
+                                        stats, minNumJokersRequired, totalNumJokers);
+    return std::max(result, 0);
+  }
+
+  // The states that isValid searched without finding a valid arrangement, by value, run state and
+  // number of jokers used. A bitset, or a hash set for rules with too many states for one.
+  struct DeadStatesT {
+    std::conditional_t<DENSE, std::vector<uint64_t>, std::unordered_set<uint64_t>> states;
+    std::vector<uint32_t> words; // the words of the bitset that have bits set
+
+    static uint64_t key(const int value, const StateT state, const int numJokersUsed) {
+      return (uint64_t(value - 1) * WIDTH + state) * NUM_JOKER_COUNTS + numJokersUsed;
+    }
+    bool contains(const uint64_t key) const {
+      if constexpr (DENSE) {
+        return key / 64 < states.size() && (states[key / 64] >> (key % 64)) & 1;
+      } else {
+        return states.contains(key);
+      }
+    }
+    void insert(const uint64_t key) {
+      if constexpr (DENSE) {
+        states.resize((N * WIDTH * NUM_JOKER_COUNTS + 63) / 64);
+        states[key / 64] |= uint64_t(1) << (key % 64);
+        words.push_back(key / 64);
+      } else {
+        states.insert(key);
+      }
+    }
+    void clear() {
+      if constexpr (DENSE) {
+        for (const uint32_t word : words) {
+          states[word] = 0;
+        }
+        words.clear();
+      } else {
+        states.clear();
+      }
+    }
+  };
+
+  // The search of isValid, depth first from the first value. Stops at the first way to play the
+  // last value that plays every tile and joker.
+  static bool isFeasible(const int value, const StateT state, const int numJokersUsed,
+                         CountsT& tiles, CountsT& table, const int numJokers,
+                         DeadStatesT& deadStates) {
+    if (value > N) { // every joker has to be played
+      return numJokersUsed == numJokers;
+    }
+    const uint64_t key = DeadStatesT::key(value, state, numJokersUsed);
+    if (deadStates.contains(key)) {
+      return false;
+    }
+    bool found = false;
+    NoStats stats;
+    forEachChoice(value, state, numJokersUsed, tiles, table, LayoutT{}, numJokers, stats,
+                  [&](const StateT newState, const int newNumJokersUsed, const int,
+                      const ChoiceT&) {
+                    found = isFeasible(value + 1, newState, newNumJokersUsed, tiles, table,
+                                       numJokers, deadStates);
+                    return found;
+                  });
+    if (!found) {
+      deadStates.insert(key);
+    }
+    return found;
+  }
+
+  // pendingScores[value - 1][r] is what the tiles in the runs i2r[r] that are shorter than three
+  // score when the runs are completed at a later value
+  static constexpr auto pendingScores = [] {
+    std::array<std::array<int, NUM_RUNS>, N> scores{};
+    for (int value = 1; value <= N; ++value) {
+      for (int r = 0; r < NUM_RUNS; ++r) {
+        for (const int length : i2r[r]) {
+          for (int d = 1; length < 3 && d <= length && value - d >= 1; ++d) {
+            scores[value - 1][r] += Scoring::tile(value - d);
+          }
+        }
+      }
+    }
+    return scores;
+  }();
+
+  // Upper bounds on what the values from value on can add, see upperBound
+  struct BoundsT {
+    // rest[value - 1] is the score of every tile of the value and above, and the similarity of the
+    // board sets of those values
+    std::array<int, N + 1> rest{};
+    // jokers[value - 1] is the best score of a joker at the value or above
+    std::array<int, N + 1> jokers{};
+  };
+
+  static BoundsT getBounds(const CountsT& tiles, const LayoutT& layout) {
+    BoundsT bounds;
+    for (int value = N; value >= 1; --value) {
+      int similarity = 0;
+      for (int k = 0; k < K; ++k) {
+        bounds.rest[value - 1] += tiles.get(k, value) * Scoring::tile(value) * SIMILARITY_SCALE;
+        similarity += layout.links[k][value - 1];
+      }
+      for (const uint8_t colors : layout.groups[value - 1]) {
+        similarity += std::popcount(unsigned(colors));
+      }
+      similarity += std::popcount(unsigned(layout.boundaries[value - 1]));
+      bounds.rest[value - 1] += bounds.rest[value] + similarity;
+      bounds.jokers[value - 1] =
+          std::max(bounds.jokers[value], Scoring::joker(value) * SIMILARITY_SCALE);
+    }
+    return bounds;
+  }
+
+  // An upper bound on the best score from the state. Every tile of the value and above is played,
+  // every run shorter than three is completed and every joker left gets the best joker score.
+  static int upperBound(const BoundsT& bounds, const int value, const StateT state,
+                        const int numJokersUsed, const int minNumJokersRequired,
+                        const int totalNumJokers) {
+    if (value > N) {
+      return numJokersUsed < minNumJokersRequired ? INVALID : 0;
+    }
+    const RunsT runs = runsFromIndex(state);
+    int pending = 0;
+    for (int k = 0; k < K; ++k) {
+      pending += pendingScores[value - 1][runs[k]];
+    }
+    return bounds.rest[value - 1] + pending * SIMILARITY_SCALE +
+           (totalNumJokers - numJokersUsed) * bounds.jokers[value - 1];
+  }
+
+  // Same search as _maxScore<false>, but a way to play is skipped if its score plus the upper bound
+  // of its next state is not above floor or the best way found so far. Returns the best score from
+  // the state if it is above floor, and otherwise an upper bound on it that is at most floor. Those
+  // bounds are stored as -1 - bound, which does not clash with the scores since they are never
+  // negative apart from INVALID. The best score from a state is above floor if and only if the
+  // returned score is, so the choices on the path of the best configuration are always stored.
+  static int _boundedScore(const int value,                //
+                           const StateT state,             //
+                           const int numJokersUsed,        //
+                           CountsT& tiles,                 //
+                           CountsT& table,                 //
+                           auto& context,                  //
+                           auto& stats,                    //
+                           const BoundsT& bounds,          //
+                           const int floor,                //
+                           const int minNumJokersRequired, //
+                           const int totalNumJokers) {     //
+    int upper = upperBound(bounds, value, state, numJokersUsed, minNumJokersRequired,
+                           totalNumJokers);
+    if (value > N) {
+      return upper;
+    }
+
+    ScoreEntry& entry = context.score(value, state, numJokersUsed);
+    const uint32_t generation = context.generation(value);
+    if (entry.generation == generation) {
+      if (entry.score >= 0 || entry.score == INVALID) {
+        if constexpr (COUNTING<decltype(stats)>) {
+          stats.memoHits += 1;
+        }
+        return entry.score;
+      }
+      upper = std::min(upper, -1 - entry.score);
+    }
+    if (upper <= floor) {
+      return upper;
+    }
+    if constexpr (COUNTING<decltype(stats)>) {
+      stats.statesExpanded += 1;
+    }
+
+    int answer = INVALID;
+    ChoiceT best;
+    int bound = INVALID; // the best score of the ways to play that were not better than target
+    forEachChoice(value, state, numJokersUsed, tiles, table, context.layout, totalNumJokers, stats,
+                  [&](const StateT newState, const int newNumJokersUsed, const int score,
+                      const ChoiceT& choice) {
+                    const int target = std::max(floor, answer);
+                    const int rest = upperBound(bounds, value + 1, newState, newNumJokersUsed,
+                                                minNumJokersRequired, totalNumJokers);
+                    if (score + rest <= target) {
+                      if constexpr (COUNTING<decltype(stats)>) {
+                        stats.boundCutoffs += 1;
+                      }
+                      bound = std::max(bound, score + rest);
+                      return;
+                    }
+                    const int result =
+                        score + _boundedScore(value + 1, newState, newNumJokersUsed, tiles, table,
+                                              context, stats, bounds, target - score,
+                                              minNumJokersRequired, totalNumJokers);
+                    if (result > target) {
+                      answer = result;
+                      best = choice;
+                    } else {
+                      bound = std::max(bound, result);
+                    }
+                  });
+
+    if (answer >= 0) {
+      context.choice(value, state, numJokersUsed) = best;
+      entry = {generation, answer};
+      return answer;
+    }
+    if (bound < 0) { // every way to play is invalid
+      entry = {generation, INVALID};
+      return INVALID;
+    }
+    entry = {generation, -1 - bound};
+    return bound;
+  }
+
+  // The score of a configuration found by playing each value the way with the best score plus
+  // upper bound of its next state, without going back. INVALID if that gets stuck.
+  static int greedyScore(CountsT& tiles, CountsT& table, const LayoutT& layout,
+                         const BoundsT& bounds, const int minNumJokersRequired,
+                         const int totalNumJokers) {
+    NoStats stats;
+    StateT state = NO_RUNS;
+    int numJokersUsed = 0;
+    int total = 0;
+    for (int value = 1; value <= N; ++value) {
+      int bestEstimate = INVALID;
+      int bestScore = 0;
+      StateT bestState = NO_RUNS;
+      int bestNumJokersUsed = 0;
+      forEachChoice(value, state, numJokersUsed, tiles, table, layout, totalNumJokers, stats,
+                    [&](const StateT newState, const int newNumJokersUsed, const int score,
+                        const ChoiceT&) {
+                      const int estimate =
+                          score + upperBound(bounds, value + 1, newState, newNumJokersUsed,
+                                             minNumJokersRequired, totalNumJokers);
+                      if (estimate > bestEstimate) {
+                        bestEstimate = estimate;
+                        bestScore = score;
+                        bestState = newState;
+                        bestNumJokersUsed = newNumJokersUsed;
+                      }
+                    });
+      if (bestEstimate < 0) {
+        return INVALID;
+      }
+      total += bestScore;
+      state = bestState;
+      numJokersUsed = bestNumJokersUsed;
+    }
+    return total;
+  }
+
+  // Same result as maxScore. The greedy configuration is a lower bound on the best score, so the
+  // search starts with the floor just below it.
+  static int boundedMaxScore(auto& context, const CountsT& table, const CountsT& hand,
+                             const int numJokersOnTable, const int numJokersInHand,
+                             const int lastValue, auto& stats) {
+    context.invalidate(lastValue);
+    CountsT tiles = getTiles(table, hand);
+    CountsT constraint = table;
+    const int minNumJokersRequired = numJokersOnTable;
+    const int totalNumJokers = numJokersOnTable + numJokersInHand;
+
+    const BoundsT bounds = getBounds(tiles, context.layout);
+    const int greedy = greedyScore(tiles, constraint, context.layout, bounds, minNumJokersRequired,
+                                   totalNumJokers);
+    const int result =
+        _boundedScore(1, NO_RUNS, 0, tiles, constraint, context, stats, bounds,
+                      greedy == INVALID ? INVALID : greedy - 1, minNumJokersRequired,
+                      totalNumJokers);
+    return std::max(result, 0);
+  }
+
+  // Scores of the positions with one more tile in the hand, without the score of the board alone,
+  // see drawValueTable. The tiles of value
+  // v only change the ways to play the values v - 2 to v, since runs are only started if the tiles
+  // of the next two values allow it. So the best score with an extra tile of value v is the best over
+  // the states of value v - 2 of the score to reach the state plus the score from the state on.
+  // The scores to reach the states are found once by a forward pass over the current position.
+  // Draws are tried in order of value so that the entries of the values above v are still those
+  // of the current position, and only the entries of the values up to v are recomputed.
+  // So each draw still searches the three values v - 2 to v from every reachable state, about a
+  // quarter of a solve, and that is most of the cost of a table. Those entries depend on the tiles
+  // of value v, including through the check that a run can be finished before it is started, so
+  // they can not be shared between the draws of different tiles.
+  static std::array<int, K * N + 1> drawScores(auto& context, const CountsT& table,
+                                               const CountsT& hand, const int numJokersOnTable,
+                                               const int numJokersInHand) {
+    NoStats stats;
+    // what the board scores when nothing is played from the hand, 0 if it is not valid and then
+    // nothing can be played
+    const int boardScore =
+        maxScore(context, table, CountsT{}, numJokersOnTable, 0, N, stats) / SIMILARITY_SCALE;
+    std::array<int, K * N + 1> scores;
+    scores.fill(maxScore(context, table, hand, numJokersOnTable, numJokersInHand, N, stats) /
+                    SIMILARITY_SCALE -
+                boardScore);
+
+    CountsT tiles = getTiles(table, hand);
+    CountsT constraint = table;
+    const int minNumJokersRequired = numJokersOnTable;
+    const int totalNumJokers = numJokersOnTable + numJokersInHand;
+
+    // reachable[value - 1] lists the states of the value that can be reached from the first state,
+    // with the best score of the tiles of the previous values
+    struct PrefixT {
+      StateT state;
+      int numJokersUsed;
+      int score;
+    };
+    std::array<std::vector<PrefixT>, N> reachable;
+    reachable[0].push_back({NO_RUNS, 0, 0});
+
+    // the best score to reach each state of the next value, INVALID if it has not been reached
+    std::conditional_t<DENSE, std::vector<int>, std::unordered_map<uint64_t, int>> best;
+    if constexpr (DENSE) {
+      best.assign(WIDTH * NUM_JOKER_COUNTS, INVALID);
+    }
+    auto bestRef = [&](const uint64_t key) -> int& {
+      if constexpr (DENSE) {
+        return best[key];
+      } else {
+        return best.try_emplace(key, INVALID).first->second;
+      }
+    };
+    std::vector<uint64_t> reached;
+    for (int value = 1; value < N - 2; ++value) {
+      for (const PrefixT& prefix : reachable[value - 1]) {
+        forEachChoice(value, prefix.state, prefix.numJokersUsed, tiles, constraint, context.layout,
+                      totalNumJokers, stats,
+                      [&](const StateT newState, const int newNumJokersUsed, const int score,
+                          const ChoiceT&) {
+                        const uint64_t key =
+                            uint64_t(newState) * NUM_JOKER_COUNTS + newNumJokersUsed;
+                        int& bestScore = bestRef(key);
+                        if (bestScore == INVALID) {
+                          reached.push_back(key);
+                        }
+                        bestScore = std::max(bestScore, prefix.score + score);
+                      });
+      }
+      for (const uint64_t key : reached) {
+        int& bestScore = bestRef(key);
+        reachable[value].push_back(
+            {StateT(key / NUM_JOKER_COUNTS), int(key % NUM_JOKER_COUNTS), bestScore});
+        bestScore = INVALID;
+      }
+      reached.clear();
+    }
+
+    for (int value = 1; value <= N; ++value) {
+      const int first = std::max(1, value - 2);
+      for (int k = 0; k < K; ++k) {
+        if (tiles.get(k, value) >= M) { // every copy is in play
+          continue;
+        }
+        tiles.add(k, value);
+        context.invalidate(value);
+        int answer = INVALID;
+        for (const PrefixT& prefix : reachable[first - 1]) {
+          answer = std::max(answer, prefix.score + _maxScore<false>(first, prefix.state,
+                                                                    prefix.numJokersUsed, tiles,
+                                                                    constraint, context, stats,
+                                                                    minNumJokersRequired,
+                                                                    totalNumJokers));
+        }
+        scores[k * N + value - 1] = std::max(answer, 0) / SIMILARITY_SCALE - boardScore;
+        tiles.remove(k, value);
+      }
+    }
+
+    if (totalNumJokers < MAX_NUM_JOKERS) {
+      scores[K * N] =
+          maxScore(context, table, hand, numJokersOnTable, numJokersInHand + 1, N, stats) /
+              SIMILARITY_SCALE -
+          boardScore;
+    }
+    return scores;
+  }
+
+  // Same as maxScore, but every way to play the tiles of value 1 is searched as a separate task on
+  // the pool. The workers share the score table.
+  static int parallelMaxScore(DenseContext& context, const CountsT& table, const CountsT& hand,
+                              const int numJokersOnTable, const int numJokersInHand,
+                              ThreadPool& pool) {
+    const int value = 1;
+    context.invalidate(N);
+    CountsT tiles = getTiles(table, hand);
+    CountsT constraint = table;
+    const int numJokersUsed = 0;
+    const int minNumJokersRequired = numJokersOnTable;
+    const int totalNumJokers = numJokersOnTable + numJokersInHand;
+
+    // the workers would race on the counters
+    NoStats stats;
+    auto& branches = context.branches;
+    branches.clear();
+    forEachChoice(value, NO_RUNS, numJokersUsed, tiles, constraint, context.layout,
+                  totalNumJokers, stats,
+                  [&](const StateT newState, const int newNumJokersUsed, const int score,
+                      const ChoiceT& choice) {
+                    branches.push_back({newState, newNumJokersUsed, score, choice, INVALID});
+                  });
+
+    pool.parallelFor(branches.size(), [&](size_t i, int) {
+      // tiles and table are modified while a worker recurses, so every branch gets its own copy
+      auto branchTiles = tiles;
+      auto branchTable = constraint;
+      auto& branch = branches[i];
+      branch.result =
+          branch.score + _maxScore<true>(value + 1, branch.state, branch.numJokersUsed, branchTiles,
+                                         branchTable, context, stats, minNumJokersRequired,
+                                         totalNumJokers);
+    });
+
+    // pick the first best branch, which is the one the serial search would pick
+    int answer = INVALID;
+    for (const auto& branch : branches) {
+      if (branch.result > answer) {
+        answer = branch.result;
+        context.choice(value, NO_RUNS, numJokersUsed) = branch.choice;
+      }
+    }
+    if (answer < 0) {
+      answer = INVALID;
+    }
+    context.score(value, NO_RUNS, numJokersUsed) = {context.generation(value), answer};
+    return std::max(answer, 0);
+  }
+
+  // Same result as maxScore, but instead of recursing from the first state the table is filled
+  // value by value from N down to 1, over every run state and number of jokers used. Each entry
+  // only reads entries of the next value, so the entries of a value can be filled in any order and
+  // in parallel if a pool is given. The values above lastValue must have been filled by this
+  // engine, for a position with the same tiles in those values.
+  static int bottomUpMaxScore(DenseContext& context, const CountsT& table, const CountsT& hand,
+                              const int numJokersOnTable, const int numJokersInHand,
+                              ThreadPool* pool, int lastValue, auto& stats) {
+    // the entries of a value also depend on the tiles of the three values below it through
+    // jokersNeeded
+    lastValue = context.invalidate(lastValue == 0 ? 0 : std::min(N, lastValue + 3));
+    CountsT tiles = getTiles(table, hand);
+    CountsT constraint = table;
+    const int minNumJokersRequired = numJokersOnTable;
+    const int totalNumJokers = numJokersOnTable + numJokersInHand;
+
+    // A run state can only be reached if the runs in it could have been built from the tiles of the
+    // previous values plus the jokers used so far. jokersNeeded[k][r] is the number of jokers that
+    // color k needs to have the runs i2r[r], entries of states that need more jokers than were used
+    // are marked INVALID without searching them.
+    std::array<std::array<int, NUM_RUNS>, K> jokersNeeded;
+    auto findJokersNeeded = [&](const int value) {
+      for (int k = 0; k < K; ++k) {
+        for (int r = 0; r < NUM_RUNS; ++r) {
+          jokersNeeded[k][r] = 0;
+          for (int d = 1; d <= 3; ++d) {
+            int needed = 0;
+            for (const int length : i2r[r]) {
+              needed += int(length >= d);
+            }
+            if (needed > 0 && value - d < 1) {
+              jokersNeeded[k][r] = MAX_NUM_JOKERS + 1;
+            } else if (needed > 0) {
+              jokersNeeded[k][r] += std::max(0, needed - tiles.get(k, value - d));
+            }
+          }
+        }
+      }
+    };
+
+    auto fill = [&](const int value, const StateT state, CountsT& tiles, CountsT& table,
+                    auto& workerStats) {
+      const RunsT runs = runsFromIndex(state);
+      int numJokersNeeded = 0;
+      for (int k = 0; k < K; ++k) {
+        numJokersNeeded += jokersNeeded[k][runs[k]];
+      }
+      for (int numJokersUsed = 0; numJokersUsed <= totalNumJokers; ++numJokersUsed) {
+        if (numJokersUsed < numJokersNeeded) {
+          context.score(value, state, numJokersUsed) = {context.generation(value), INVALID};
+          continue;
+        }
+        if constexpr (COUNTING<decltype(workerStats)>) {
+          workerStats.statesExpanded += 1;
+        }
+        int answer = INVALID;
+        ChoiceT best;
+        forEachChoice(value, state, numJokersUsed, tiles, table, context.layout, totalNumJokers,
+                      workerStats,
+                      [&](const StateT newState, const int newNumJokersUsed, const int score,
+                          const ChoiceT& choice) {
+                        int rest = 0;
+                        if (value == N) {
+                          rest = newNumJokersUsed < minNumJokersRequired ? INVALID : 0;
+                        } else {
+                          rest = context.score(value + 1, newState, newNumJokersUsed).score;
+                        }
+                        const int result = score + rest;
+                        if (result > answer) {
+                          answer = result;
+                          best = choice;
+                        }
+                      });
+        if (answer < 0) {
+          answer = INVALID;
+        } else {
+          context.choice(value, state, numJokersUsed) = best;
+        }
+        context.score(value, state, numJokersUsed) = {context.generation(value), answer};
+      }
+    };
+
+    // tiles and table are modified while an entry is filled, so each worker gets its own copy
+    std::vector<std::pair<CountsT, CountsT>> workerArrays;
+    if (pool != nullptr) {
+      workerArrays.assign(pool->size(), {tiles, constraint});
+    }
+
+    for (int value = lastValue; value >= 2; --value) {
+      findJokersNeeded(value);
+      if (pool != nullptr) {
+        pool->parallelFor(WIDTH, [&](size_t state, int worker) {
+          auto& [workerTiles, workerTable] = workerArrays[worker];
+          NoStats workerStats;
+          fill(value, StateT(state), workerTiles, workerTable, workerStats);
+        });
+      } else {
+        for (int state = 0; state < WIDTH; ++state) {
+          fill(value, StateT(state), tiles, constraint, stats);
+        }
+      }
+    }
+    // only the state where no runs have been started is reachable at the first value
+    findJokersNeeded(1);
+    fill(1, NO_RUNS, tiles, constraint, stats);
+
+    return std::max(context.score(1, NO_RUNS, 0).score, 0);
+  }
+
+  // Follows the choices from the first state to rebuild the best configuration found by maxScore.
+  // Returns the sets in the configuration and the tiles from the hand that were played.
+  static std::pair<std::vector<TileSet>, std::vector<Tile>>
+  getTileSetsFromMemo(auto& context, CountsT& table, int numJokersOnTable) {
+    return getTileSetsFromChoices(
+        table, numJokersOnTable, [&](const int value, const StateT state, const int numJokersUsed) {
+          return context.choice(value, state, numJokersUsed);
+        });
+  }
+
+  // Rebuilds a configuration from the choice made at each value, choiceAt(value, state,
+  // numJokersUsed) is called once per value in increasing order.
+  static std::pair<std::vector<TileSet>, std::vector<Tile>>
+  getTileSetsFromChoices(CountsT& table, int numJokersOnTable, auto&& choiceAt) {
+    std::vector<TileSet> tileSets;
+    std::vector<Tile> handSubset;
+
+    // The runs that can still be extended, in the same order as the lengths in i2r. A run that
+    // ends before it has three tiles was discarded by the search so it is dropped here too.
+    std::array<std::array<TileSet, M>, K> openRuns;
+    auto endRun = [&](TileSet& run) {
+      if (run.size() >= 3) {
+        tileSets.push_back(run);
+      }
+      run.tiles.clear();
+    };
+
+    // Jokers are assigned to tiles after discarded runs are known, since the search assumes that
+    // discarded tiles are not jokers.
+    std::array<std::array<int, MAX_NUM_JOKERS>, N> jokers;
+
+    RunsT runs{};
+    int numJokersUsed = 0;
+    for (int value = 1; value <= N; ++value) {
+      const ChoiceT choice = choiceAt(value, stateIndex(runs), numJokersUsed);
+
+      // collect runs
+      for (int k = 0; k < K; ++k) {
+        const RunT& lengths = i2r[runs[k]];
+        RunT newLengths;
+        for (int i = 0; i < M; ++i) {
+          if ((choice.extensions[k] >> i) & 1) {
+            openRuns[k][i].tiles.push_back(Tile{value, k, false});
+            newLengths[i] = std::min(3, lengths[i] + 1);
+          } else {
+            endRun(openRuns[k][i]);
+            newLengths[i] = 0;
+          }
+        }
+        // The search sorts the lengths of the runs after extending them. Sort the open runs the
+        // same way, the sort must be stable so that runs of equal length keep their order.
+        std::array<int, M> order;
+        for (int i = 0; i < M; ++i) {
+          order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int i, int j) { return newLengths[i] < newLengths[j]; });
+        std::array<TileSet, M> sortedRuns;
+        for (int i = 0; i < M; ++i) {
+          sortedRuns[i] = std::move(openRuns[k][order[i]]);
+        }
+        openRuns[k] = std::move(sortedRuns);
+        runs[k] = r2i(newLengths);
+      }
+
+      // collect groups
+      for (const uint8_t group : choice.groups) {
+        if (group == 0) {
+          break;
+        }
+        TileSet s;
+        for (int k = 0; k < K; ++k) {
+          if ((group >> k) & 1) {
+            s.tiles.push_back(Tile{value, k, false});
+          }
+        }
+        tileSets.push_back(s);
+      }
+
+      for (int i = 0; i < MAX_NUM_JOKERS; ++i) {
+        jokers[value - 1][i] = choice.jokers[i] == NO_CHOICE ? EMPTY : choice.jokers[i];
+        numJokersUsed += int(choice.jokers[i] != NO_CHOICE);
+      }
+    }
+    for (auto& colorRuns : openRuns) {
+      for (auto& run : colorRuns) {
+        endRun(run);
+      }
+    }
+
+    // assign jokers and decide which tiles come from the hand
+    for (auto& s : tileSets) {
+      for (auto& tile : s.tiles) {
+        const int n = tile.faceValue;
+        const int k = tile.color;
+        for (int& joker : jokers[n - 1]) {
+          if (joker == k) {
+            tile.isJoker = true;
+            joker = EMPTY;
+            break;
+          }
+        }
+        if (tile.isJoker && numJokersOnTable > 0) {
+          numJokersOnTable -= 1;
+        } else if (tile.isJoker) {
+          handSubset.push_back(tile);
+        } else if (table.get(k, n) > 0) {
+          table.remove(k, n);
+        } else {
+          handSubset.push_back(tile);
+        }
+      }
+    }
+    return {tileSets, handSubset};
+  }
+
+  static std::tuple<CountsT, CountsT, int, int>
+  getArraysFromTileSets(const std::vector<TileSet>& board, const std::vector<Tile>& rack) {
+    int numJokersOnTable = 0;
+    int numJokersInHand = 0;
+
+    // rack
+    CountsT hand{};
+    for (auto& tile : rack) {
+      if (tile.isJoker) {
+        numJokersInHand += 1;
+      } else {
+        hand.add(tile.color, tile.faceValue);
+      }
+    }
+    // table
+    CountsT table{};
+    for (auto& s : board) {
+      for (auto tile : s.tiles) {
+        if (tile.isJoker) {
+          numJokersOnTable += 1;
+        } else {
+          table.add(tile.color, tile.faceValue);
+        }
+      }
+    }
+
+    return {table, hand, numJokersOnTable, numJokersInHand};
+  }
+
+  static LayoutT getLayout(const std::vector<TileSet>& board) {
+    LayoutT layout;
+    // bit value of starts[k] and ends[k] is set if a board run of color k starts or ends at value
+    std::array<uint32_t, K> starts{};
+    std::array<uint32_t, K> ends{};
+    for (const auto& s : board) {
+      if (s.isRun()) {
+        // the tiles of a run are in order, so a joker stands for the value between its neighbours
+        const auto tile = std::find_if(s.tiles.begin(), s.tiles.end(),
+                                       [](const Tile& t) { return !t.isJoker; });
+        if (tile == s.tiles.end()) {
+          continue;
+        }
+        const int firstValue = tile->faceValue - int(tile - s.tiles.begin());
+        const int lastValue = firstValue + s.size() - 1;
+        for (int value = std::max(2, firstValue + 1); value <= std::min(N, lastValue); ++value) {
+          layout.links[tile->color][value - 1] += 1;
+        }
+        // a run whose jokers stand for values past the face values has no boundary there
+        starts[tile->color] |= firstValue >= 1 ? 1u << firstValue : 0;
+        ends[tile->color] |= lastValue <= N ? 1u << lastValue : 0;
+      } else if (s.isGroup()) {
+        uint8_t colors = 0;
+        for (const Tile& tile : s.tiles) {
+          colors |= tile.isJoker ? 0 : 1 << tile.color;
+        }
+        if (std::popcount(unsigned(colors)) != s.size()) {
+          continue;
+        }
+        auto& groups = layout.groups[s.tiles[0].faceValue - 1];
+        const auto slot = std::find(groups.begin(), groups.end(), 0);
+        if (slot != groups.end()) {
+          *slot = colors;
+        }
+      }
+    }
+    for (int k = 0; k < K; ++k) {
+      for (int value = 2; value <= N; ++value) {
+        if (((ends[k] >> (value - 1)) & 1) && ((starts[k] >> value) & 1)) {
+          layout.boundaries[value - 1] |= 1 << k;
+        }
+      }
+    }
+    return layout;
+  }
+
+  // Find maximum value play from the arrays returned by getArrays, search(table, hand,
+  // numJokersOnTable, numJokersInHand) fills the tables of the context and returns the max score
+  static std::pair<std::vector<TileSet>, std::vector<Tile>>
+  solveWith(auto& context, auto&& getArrays, auto& stats, auto&& search) {
+    using Clock = std::chrono::steady_clock;
+    [[maybe_unused]] Clock::time_point start;
+    if constexpr (COUNTING<decltype(stats)>) {
+      start = Clock::now();
+    }
+    // adds the time since the last lap to time
+    [[maybe_unused]] auto lap = [&](std::chrono::nanoseconds& time) {
+      const Clock::time_point now = Clock::now();
+      time += now - start;
+      start = now;
+    };
+
+    CountsT table;
+    CountsT hand;
+    int numJokersOnTable;
+    int numJokersInHand;
+    std::tie(table, hand, numJokersOnTable, numJokersInHand) = getArrays();
+    if constexpr (COUNTING<decltype(stats)>) {
+      lap(stats.arrayTime);
+    }
+
+    // get tiles in best play
+    const int maxscore = search(table, hand, numJokersOnTable, numJokersInHand);
+    if constexpr (COUNTING<decltype(stats)>) {
+      lap(stats.searchTime);
+    }
+
+    if (maxscore <= 0) {
+      return {{}, {}};
+    }
+
+    std::vector<TileSet> tileSets;
+    std::vector<Tile> handSubset;
+    std::tie(tileSets, handSubset) = getTileSetsFromMemo(context, table, numJokersOnTable);
+    if constexpr (COUNTING<decltype(stats)>) {
+      lap(stats.reconstructionTime);
+    }
+
+    return {tileSets, handSubset};
+  }
+
+  DenseContext& denseContext() {
+    if (!dense) {
+      dense = std::make_unique<DenseContext>();
+    }
+    return *dense;
+  }
+
+  // Calls f with the context of the table mode
+  decltype(auto) withContext(auto&& f) {
+    if constexpr (DENSE) {
+      if (tableMode == TableMode::Dense) {
+        return f(denseContext());
+      }
+    }
+    return f(compact);
+  }
+
+  // Fills the table of the context with the selected engine, keeping the entries of the values
+  // above lastValue
+  int runEngine(auto& context, const CountsT& table, const CountsT& hand,
+                const int numJokersOnTable, const int numJokersInHand, const int lastValue,
+                auto& stats) {
+    if constexpr (std::is_same_v<std::remove_cvref_t<decltype(context)>, DenseContext>) {
+      if (engine == Engine::BottomUp) {
+        return bottomUpMaxScore(context, table, hand, numJokersOnTable, numJokersInHand, nullptr,
+                                lastValue, stats);
+      }
+    }
+    if (engine == Engine::BranchAndBound) {
+      return boundedMaxScore(context, table, hand, numJokersOnTable, numJokersInHand, lastValue,
+                             stats);
+    }
+    return maxScore(context, table, hand, numJokersOnTable, numJokersInHand, lastValue, stats);
+  }
+
+  std::pair<std::vector<TileSet>, std::vector<Tile>>
+  serialSolve(const LayoutT& layout, const auto& getArrays, auto& stats) {
+    lastChangedValue = N;
+    return withContext([&](auto& context) {
+      context.layout = layout;
+      return solveWith(context, getArrays, stats, [&](const auto&... arrays) {
+        return runEngine(context, arrays..., N, stats);
+      });
+    });
+  }
+
+  std::pair<std::vector<TileSet>, std::vector<Tile>> incrementalSolve(auto& stats) {
+    // the engines fill the table differently, so the entries of one can not be kept for the other,
+    // and each table mode has its own table
+    if (engine != incrementalEngine || tableMode != incrementalTableMode) {
+      incrementalEngine = engine;
+      incrementalTableMode = tableMode;
+      lastChangedValue = N;
+    }
+    const int lastValue = lastChangedValue;
+    lastChangedValue = 0;
+    return withContext([&](auto& context) {
+      context.layout = boardLayout;
+      return solveWith(
+          context,
+          [&] { return std::tuple(boardCounts, rackCounts, numJokersOnBoard, numJokersInRack); },
+          stats,
+          [&](const auto&... arrays) { return runEngine(context, arrays..., lastValue, stats); });
+    });
+  }
+
+  // replaces counts and numJokers with the tiles, and marks the values that changed
+  void setCounts(const std::vector<Tile>& tiles, CountsT& counts, int& numJokers) {
+    CountsT newCounts{};
+    int newNumJokers = 0;
+    for (const Tile& tile : tiles) {
+      if (tile.isJoker) {
+        newNumJokers += 1;
+      } else {
+        newCounts.add(tile.color, tile.faceValue);
+      }
+    }
+    lastChangedValue = std::max(lastChangedValue, newCounts.lastDifferentValue(counts));
+    if (newNumJokers != numJokers) {
+      lastChangedValue = N;
+    }
+    counts = newCounts;
+    numJokers = newNumJokers;
+  }
+
+  DeadStatesT deadStates; // used by isValid
+
+  // the dense table is only allocated when it is first used
+  std::unique_ptr<DenseContext> dense;
+  CompactContext compact;
+  Engine engine = Engine::TopDown;
+  TableMode tableMode = TableMode::Dense;
+
+  // the position changed by setBoard, setRack, addRackTile and removeRackTile
+  CountsT boardCounts{};
+  LayoutT boardLayout{};
+  CountsT rackCounts{};
+  int numJokersOnBoard = 0;
+  int numJokersInRack = 0;
+  // the entries of the values up to this one do not match the position
+  int lastChangedValue = N;
+  Engine incrementalEngine = Engine::TopDown;
+  TableMode incrementalTableMode = TableMode::Dense;
+};
@@ -0,0 +1,670 @@
+// Checks of the solver and the tile sets on generated positions. Prints the checks that fail and
+// exits with 1 if any did.
+//
+//   g++ -std=c++20 -O2 -c Position*.cxx Search.cxx Simulator.cxx TileSet.cxx ThreadPool.cxx
+//   g++ -std=c++20 -O2 -pthread Tests.cxx *.o -o tests
+//   ./tests
+#include "PositionText.hxx"
+#include "Search.hxx"
+#include "Simulator.hxx"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+static const int NUM_POSITIONS = 300;
+
+static int numFailed = 0;
+
+static void check(const bool ok, const char* test, const int position) {
+  if (!ok) {
+    std::printf("%s failed on position %d\n", test, position);
+    numFailed += 1;
+  }
+}
+
+// Whether the tiles are the same tile of the game, every joker is the same tile
+static bool sameTile(const Tile& a, const Tile& b) {
+  return a.isJoker ? bool(b.isJoker)
+                   : !b.isJoker && a.faceValue == b.faceValue && a.color == b.color;
+}
+
+// A board of the sets that solve plays from some of the tiles and a rack of some of the others
+static Position generatePosition(std::mt19937_64& rng) {
+  vector<Tile> tiles;
+  for (int copy = 0; copy < 2; ++copy) {
+    for (int k = 0; k < 4; ++k) {
+      for (int value = 1; value <= 13; ++value) {
+        tiles.push_back(Tile{value, k});
+      }
+    }
+    tiles.push_back(Tile{1, 0, true});
+  }
+  std::shuffle(tiles.begin(), tiles.end(), rng);
+  const size_t numForBoard = std::uniform_int_distribution<size_t>(0, 60)(rng);
+  const size_t rackSize = std::uniform_int_distribution<size_t>(1, 20)(rng);
+
+  Position position;
+  vector<TileSet> none;
+  vector<Tile> forBoard(tiles.begin(), tiles.begin() + numForBoard);
+  position.board = solve(none, forBoard).first;
+  vector<Tile> played;
+  for (const TileSet& s : position.board) {
+    played.insert(played.end(), s.tiles.begin(), s.tiles.end());
+  }
+  // the tiles of the board that solve did not play go back with the others
+  for (auto tile = tiles.begin(); tile != tiles.begin() + numForBoard; ++tile) {
+    const auto same = std::find_if(played.begin(), played.end(),
+                                   [&](const Tile& t) { return sameTile(t, *tile); });
+    if (same != played.end()) {
+      played.erase(same);
+    } else if (position.rack.size() < rackSize) {
+      position.rack.push_back(*tile);
+    }
+  }
+  for (auto tile = tiles.begin() + numForBoard;
+       tile != tiles.end() && position.rack.size() < rackSize; ++tile) {
+    position.rack.push_back(*tile);
+  }
+  return position;
+}
+
+// The sets as text that does not depend on their order or the order of their tiles. A joker only
+// shows the face value it stands for, as the color of a joker in a group is not known.
+static string setsText(const vector<TileSet>& sets) {
+  vector<string> texts;
+  for (const TileSet& s : sets) {
+    vector<string> tiles;
+    for (const Tile& tile : s.tiles) {
+      tiles.push_back(tile.isJoker ? "J" + std::to_string(tile.faceValue)
+                                   : std::to_string(tile.color) + "," +
+                                         std::to_string(tile.faceValue));
+    }
+    std::sort(tiles.begin(), tiles.end());
+    string text;
+    for (const string& t : tiles) {
+      text += t + " ";
+    }
+    texts.push_back(text);
+  }
+  std::sort(texts.begin(), texts.end());
+  string text;
+  for (const string& t : texts) {
+    text += t + "|";
+  }
+  return text;
+}
+
+// The k best configurations are different sets, and the first is the one solve finds
+static void testTopKIsDistinct(vector<Position>& positions) {
+  for (size_t i = 0; i < positions.size(); ++i) {
+    auto& [board, rack] = positions[i];
+    const auto top = solveTopK(board, rack, 10);
+    vector<string> texts;
+    for (const auto& [sets, played] : top) {
+      texts.push_back(setsText(sets));
+    }
+    std::sort(texts.begin(), texts.end());
+    check(std::adjacent_find(texts.begin(), texts.end()) == texts.end(), "topKIsDistinct", i);
+    const auto best = solve(board, rack);
+    check(top.empty() ? best.first.empty() : setsText(top[0].first) == setsText(best.first),
+          "topKStartsWithSolve", i);
+    check(solveTopK(board, rack, 0).empty() && solveTopK(board, rack, -1).empty(),
+          "topKOfNone", i);
+  }
+}
+
+// Every entry of drawValueTable is the score of solving the position with the tile drawn, or of the
+// position itself if the tile can not be drawn
+static void testDrawValueTable(vector<Position>& positions) {
+  for (size_t i = 0; i < positions.size(); i += 10) {
+    auto& [board, rack] = positions[i];
+    const std::array<int, 4 * 13 + 1> table = drawValueTable(board, rack);
+    vector<Tile> inPlay = rack;
+    for (const TileSet& s : board) {
+      inPlay.insert(inPlay.end(), s.tiles.begin(), s.tiles.end());
+    }
+    for (int draw = 0; draw < 4 * 13 + 1; ++draw) {
+      const Tile tile = draw < 4 * 13 ? Tile{draw % 13 + 1, draw / 13} : Tile{1, 0, true};
+      const auto copies = std::count_if(inPlay.begin(), inPlay.end(),
+                                        [&](const Tile& t) { return sameTile(t, tile); });
+      vector<Tile> drawn = rack;
+      if (copies < 2) {
+        drawn.push_back(tile);
+      }
+      check(table[draw] == playScore(solve(board, drawn).second), "drawValueTable", i);
+    }
+  }
+}
+
+// A solver for every engine and table mode, the dense table modes first in the order of Engine
+static vector<Solver<>> makeSolvers() {
+  vector<Solver<>> solvers(6);
+  const Engine engines[] = {Engine::TopDown, Engine::BottomUp, Engine::BranchAndBound};
+  for (int i = 0; i < 6; ++i) {
+    solvers[i].setEngine(engines[i % 3]);
+    solvers[i].setTableMode(i < 3 ? TableMode::Dense : TableMode::Compact);
+  }
+  return solvers;
+}
+
+// The configurations of every engine and table mode are those of the default top down search,
+// also when solving the same position through the incremental API or in parallel on a pool, and
+// so are those of solveBatch
+static void testEnginesAgree(vector<Position>& positions) {
+  Solver<> reference;
+  vector<Solver<>> solvers = makeSolvers();
+  ThreadPool pool(4);
+  const auto batch = solveBatch(positions, pool);
+  for (size_t i = 0; i < positions.size(); ++i) {
+    auto& [board, rack] = positions[i];
+    const string expected = setsText(reference.solve(board, rack).first);
+    check(setsText(batch[i].first) == expected, "batchAgrees", i);
+    for (Solver<>& solver : solvers) {
+      check(setsText(solver.solve(board, rack).first) == expected, "enginesAgree", i);
+      solver.setBoard(board);
+      solver.setRack(rack);
+      check(setsText(solver.solve().first) == expected, "incrementalEnginesAgree", i);
+    }
+    // the dense top down and bottom up solvers, which are the ones that solve in parallel
+    for (int j = 0; j < 2; ++j) {
+      check(setsText(solvers[j].solve(board, rack, pool).first) == expected,
+            "parallelEnginesAgree", i);
+    }
+  }
+}
+
+// Solving a board without a rack keeps the sets of the board, also when two runs of a color could
+// be joined into one. Groups with jokers are left out, the solver does not know their colors.
+static void testBoardIsKept(vector<Position>& positions) {
+  vector<TileSet> board = {TileSet({Tile{1, 0}, Tile{2, 0}, Tile{3, 0}}),
+                           TileSet({Tile{4, 0}, Tile{5, 0}, Tile{6, 0}})};
+  vector<Tile> none;
+  check(setsText(solve(board, none).first) == setsText(board), "runsAreNotJoined", 0);
+  for (size_t i = 0; i < positions.size(); ++i) {
+    board = positions[i].board;
+    const bool jokerGroups = std::any_of(board.begin(), board.end(), [](const TileSet& s) {
+      return s.isGroup() && std::any_of(s.tiles.begin(), s.tiles.end(),
+                                        [](const Tile& t) { return bool(t.isJoker); });
+    });
+    if (!jokerGroups) {
+      check(setsText(solve(board, none).first) == setsText(board), "boardIsKept", i);
+    }
+  }
+}
+
+// Solving the position kept by a solver after adding or removing one tile of the rack at a time
+// gives the configuration that a fresh solve of the same position does, for every engine and table
+// mode
+static void testRackEdits(vector<Position>& positions, std::mt19937_64& rng) {
+  vector<Solver<>> solvers = makeSolvers();
+  Solver<> reference;
+  for (size_t i = 0; i < positions.size(); i += 10) {
+    auto& [board, startRack] = positions[i];
+    // the edits, a tile that is added or a tile of the rack that is removed
+    vector<std::pair<bool, Tile>> edits;
+    vector<Tile> rack = startRack;
+    // the tiles of the board and every tile that has been in the rack, so that no tile is added
+    // when two copies of it could be in play
+    vector<Tile> inPlay = rack;
+    for (const TileSet& s : board) {
+      inPlay.insert(inPlay.end(), s.tiles.begin(), s.tiles.end());
+    }
+    for (int step = 0; step < 8; ++step) {
+      if (!rack.empty() && std::uniform_int_distribution<int>(0, 1)(rng) == 0) {
+        const size_t j = std::uniform_int_distribution<size_t>(0, rack.size() - 1)(rng);
+        edits.push_back({false, rack[j]});
+        rack.erase(rack.begin() + j);
+      } else {
+        const int draw = std::uniform_int_distribution<int>(0, 4 * 13)(rng);
+        const Tile tile = draw < 4 * 13 ? Tile{draw % 13 + 1, draw / 13} : Tile{1, 0, true};
+        if (std::count_if(inPlay.begin(), inPlay.end(),
+                          [&](const Tile& t) { return sameTile(t, tile); }) < 2) {
+          edits.push_back({true, tile});
+          rack.push_back(tile);
+          inPlay.push_back(tile);
+        }
+      }
+    }
+
+    for (Solver<>& solver : solvers) {
+      rack = startRack;
+      solver.setBoard(board);
+      solver.setRack(rack);
+      check(setsText(solver.solve().first) == setsText(reference.solve(board, rack).first),
+            "rackEditsStart", i);
+      for (const auto& [added, tile] : edits) {
+        if (added) {
+          solver.addRackTile(tile);
+          rack.push_back(tile);
+        } else {
+          check(solver.removeRackTile(tile), "removeRackTile", i);
+          rack.erase(std::find_if(rack.begin(), rack.end(),
+                                  [&](const Tile& t) { return sameTile(t, tile); }));
+        }
+        check(setsText(solver.solve().first) == setsText(reference.solve(board, rack).first),
+              "rackEdits", i);
+      }
+    }
+  }
+}
+
+// isValid says whether getTileSetsIfValid finds sets for the tiles of the generated boards, and of
+// the same boards with a tile added or removed
+static void testIsValidMatchesSets(vector<Position>& positions, std::mt19937_64& rng) {
+  for (size_t i = 0; i < positions.size(); ++i) {
+    vector<Tile> tiles;
+    for (const TileSet& s : positions[i].board) {
+      tiles.insert(tiles.end(), s.tiles.begin(), s.tiles.end());
+    }
+    vector<vector<Tile>> variants = {tiles};
+    for (int draw = 0; draw < 4 * 13 + 1; ++draw) {
+      const Tile tile = draw < 4 * 13 ? Tile{draw % 13 + 1, draw / 13} : Tile{1, 0, true};
+      if (std::count_if(tiles.begin(), tiles.end(),
+                        [&](const Tile& t) { return sameTile(t, tile); }) < 2) {
+        variants.push_back(tiles);
+        variants.back().push_back(tile);
+      }
+    }
+    for (int j = 0; j < 5 && !tiles.empty(); ++j) {
+      variants.push_back(tiles);
+      vector<Tile>& removed = variants.back();
+      removed.erase(removed.begin() +
+                    std::uniform_int_distribution<size_t>(0, removed.size() - 1)(rng));
+    }
+    for (const vector<Tile>& variant : variants) {
+      // getTileSetsIfValid finds no sets for no tiles
+      check(isValid(variant) == (variant.empty() || !getTileSetsIfValid(variant).empty()),
+            "isValidMatchesSets", i);
+    }
+  }
+}
+
+// A position solves the same from its record, and a captured solveBatch reads back from the
+// position file as the records of its positions, in their order
+static void testRecordsRoundTrip(vector<Position>& positions) {
+  for (size_t i = 0; i < positions.size(); ++i) {
+    auto& [board, rack] = positions[i];
+    check(setsText(solve(Solver<>::toRecord(board, rack)).first) ==
+              setsText(solve(board, rack).first),
+          "recordSolvesTheSame", i);
+  }
+
+  const string path = (std::filesystem::temp_directory_path() / "rummikub-tests.pos").string();
+  ThreadPool pool(4);
+  check(startCapture(path.c_str()), "startCapture", 0);
+  const auto results = solveBatch(positions, pool);
+  check(stopCapture(), "stopCapture", 0);
+  PositionFile file;
+  check(file.open(path.c_str()) && file.records().size() == positions.size(), "captureSize", 0);
+  for (size_t i = 0; i < file.records().size() && i < positions.size(); ++i) {
+    PositionRecord expected = Solver<>::toRecord(positions[i].board, positions[i].rack);
+    expected.expectedScore = playScore(results[i].second);
+    check(std::memcmp(&file.records()[i], &expected, sizeof(expected)) == 0, "captureOrder", i);
+  }
+  std::filesystem::remove(path);
+}
+
+// Solving with SolveStats finds the sets that solving without them does, and the counters add up:
+// every state searched after the first is reached by a way to play that passed the table
+// constraint, and every way to play is looked up in the group packings once
+static void testSolveStats(vector<Position>& positions) {
+  vector<Solver<>> solvers(2);
+  solvers[1].setTableMode(TableMode::Compact);
+  for (size_t i = 0; i < positions.size(); ++i) {
+    auto& [board, rack] = positions[i];
+    for (Solver<>& solver : solvers) {
+      SolveStats stats;
+      const string expected = setsText(solver.solve(board, rack).first);
+      check(setsText(solver.solve(board, rack, stats).first) == expected, "statsSameSets", i);
+      check(stats.statesExpanded > 0 && stats.fanOut > 0 && stats.searchTime.count() > 0,
+            "statsCounted", i);
+      check(stats.fanOut == stats.groupLookups && stats.maxFanOut <= stats.fanOut &&
+                stats.tableConstraintRejections <= stats.fanOut && stats.boundCutoffs == 0,
+            "statsFanOut", i);
+      check(stats.statesExpanded + stats.memoHits - 1 <=
+                stats.fanOut - stats.tableConstraintRejections,
+            "statsStatesReached", i);
+    }
+  }
+}
+
+// Whether the sets of a play are legal and hold exactly the tiles of the board and the tiles played,
+// which are tiles of the rack
+static bool isPlayOf(const vector<TileSet>& board, const vector<Tile>& rack,
+                     const std::pair<vector<TileSet>, vector<Tile>>& play) {
+  const auto& [sets, played] = play;
+  if (sets.empty()) {
+    return played.empty();
+  }
+  vector<Tile> left = rack;
+  for (const Tile& tile : played) {
+    const auto same =
+        std::find_if(left.begin(), left.end(), [&](const Tile& t) { return sameTile(t, tile); });
+    if (same == left.end()) {
+      return false;
+    }
+    left.erase(same);
+  }
+  vector<Tile> tiles = played;
+  for (const TileSet& s : board) {
+    tiles.insert(tiles.end(), s.tiles.begin(), s.tiles.end());
+  }
+  for (const TileSet& s : sets) {
+    if (!s.isLegal()) {
+      return false;
+    }
+    for (const Tile& tile : s.tiles) {
+      const auto same = std::find_if(tiles.begin(), tiles.end(),
+                                     [&](const Tile& t) { return sameTile(t, tile); });
+      if (same == tiles.end()) {
+        return false;
+      }
+      tiles.erase(same);
+    }
+  }
+  return tiles.empty();
+}
+
+// The score of the tiles under a scoring policy of Solver, a joker scores as the tile it stands for
+template <typename Scoring> static int policyScore(const vector<Tile>& tiles) {
+  int score = 0;
+  for (const Tile& tile : tiles) {
+    score += tile.isJoker ? Scoring::joker(tile.faceValue) : Scoring::tile(tile.faceValue);
+  }
+  return score;
+}
+
+// The plays under the other scoring policies are legal, score as much as the board plus the tiles
+// played, and score at least as much under their policy as the play of the standard scoring does
+template <typename Scoring>
+static void testScoringPolicy(vector<Position>& positions, const char* test) {
+  Solver<13, 4, 2, 2, Scoring> solver;
+  for (size_t i = 0; i < positions.size(); i += 5) {
+    auto& [board, rack] = positions[i];
+    const auto play = solver.solve(board, rack);
+    check(isPlayOf(board, rack, play), test, i);
+    vector<Tile> boardTiles;
+    for (const TileSet& s : board) {
+      boardTiles.insert(boardTiles.end(), s.tiles.begin(), s.tiles.end());
+    }
+    vector<Tile> setTiles;
+    for (const TileSet& s : play.first) {
+      setTiles.insert(setTiles.end(), s.tiles.begin(), s.tiles.end());
+    }
+    const int score = policyScore<Scoring>(play.second);
+    check(play.first.empty() ||
+              policyScore<Scoring>(setTiles) == policyScore<Scoring>(boardTiles) + score,
+          test, i);
+    check(score >= policyScore<Scoring>(solve(board, rack).second), test, i);
+  }
+}
+
+// The plays of a rule variant are legal plays of the rack onto a board that the variant played
+// before, with tiles from a game of K colors, M copies of every tile and J jokers
+template <int K, int M, int J> static void testRuleVariant(std::mt19937_64& rng, const char* test) {
+  Solver<13, K, M, J> solver;
+  vector<Tile> tiles;
+  for (int copy = 0; copy < M; ++copy) {
+    for (int k = 0; k < K; ++k) {
+      for (int value = 1; value <= 13; ++value) {
+        tiles.push_back(Tile{value, k});
+      }
+    }
+  }
+  tiles.insert(tiles.end(), J, Tile{1, 0, true});
+  for (int i = 0; i < 20; ++i) {
+    std::shuffle(tiles.begin(), tiles.end(), rng);
+    vector<TileSet> board;
+    vector<Tile> rack(tiles.begin(), tiles.begin() + 30);
+    const auto first = solver.solve(board, rack);
+    check(isPlayOf(board, rack, first), test, i);
+    board = first.first;
+    rack.assign(tiles.begin() + 30, tiles.begin() + 45);
+    check(isPlayOf(board, rack, solver.solve(board, rack)), test, i);
+  }
+}
+
+// Seeded games keep every tile of the game in the pool, on the board or in a rack, and games and
+// simulations with the same seed end the same, whatever the number of threads
+static void testSelfPlay() {
+  const GameRules rules;
+  for (int i = 0; i < 10; ++i) {
+    std::mt19937_64 rng(i);
+    const GameResult result = playGame(rules, rng);
+    int tiles = result.poolTiles + result.boardTiles;
+    for (const int rackTiles : result.rackTiles) {
+      tiles += rackTiles;
+    }
+    check(tiles == 4 * 13 * 2 + 2, "selfPlayKeepsTiles", i);
+
+    std::mt19937_64 again(i);
+    const GameResult replay = playGame(rules, again);
+    check(replay.winner == result.winner && replay.turns == result.turns &&
+              replay.plays == result.plays && replay.points == result.points &&
+              replay.rackTiles == result.rackTiles,
+          "selfPlayIsSeeded", i);
+  }
+
+  ThreadPool one(1);
+  ThreadPool four(4);
+  const SimulationStats a = simulate(rules, 20, 7, one);
+  const SimulationStats b = simulate(rules, 20, 7, four);
+  check(a.games == 20 && a.games == b.games && a.blocked == b.blocked && a.turns == b.turns &&
+            a.plays == b.plays && a.wins == b.wins && a.points == b.points,
+        "simulateIsSeeded", 0);
+}
+
+// The lines of rummikub-solve: the example of PositionText.hxx solves to the result shown there,
+// a blank line has no position, and lines that are not positions of the game are not read
+static void testPositionText() {
+  auto parse = [](const string& line, Position& position) {
+    return parsePosition(line.data(), line.data() + line.size(), position);
+  };
+  auto blank = [](const string& line) { return isBlank(line.data(), line.data() + line.size()); };
+  Position position;
+  check(parse("0,3 0,4 0,5 | 1,7 2,7 J ; 3,1 0,6 J\r", position) &&
+            position.board.size() == 2 && position.rack.size() == 3,
+        "parseExample", 0);
+  const auto [sets, played] = solve(position.board, position.rack);
+  string out;
+  appendResult(out, playScore(played), sets, played);
+  check(out == "31;J 1,7 2,7|0,3 0,4 0,5 0,6 J;0,6 J\n", "exampleResult", 0);
+
+  for (const string line : {"", " \t\r"}) {
+    check(blank(line) && !parse(line, position), "blankLine", 0);
+  }
+  check(!blank(";") && parse(";", position) && position.board.empty() &&
+            position.rack.empty(),
+        "emptyPosition", 0);
+  // no rack, a color or face value out of range, a tile that is not one, and three copies
+  for (const string line : {"0,3 0,4 0,5", "4,1 ;", "0,14 ;", "0,0 ;", "0,3 x ;",
+                            "0,1 0,1 ; 0,1", "J J ; J"}) {
+    check(!parse(line, position), "invalidLine", 0);
+  }
+}
+
+// The best score of a rack without jokers on an empty board, by trying every way to split it
+// into sets. counts holds the tiles of the standard game as counts[color][faceValue].
+static int bruteForceScore(std::array<std::array<int, 15>, 4>& counts) {
+  // the set of the smallest tile left, by face value and then color, or no set for it
+  int k = 0;
+  int value = 1;
+  while (value <= 13 && counts[k][value] == 0) {
+    k += 1;
+    if (k == 4) {
+      k = 0;
+      value += 1;
+    }
+  }
+  if (value > 13) {
+    return 0;
+  }
+  counts[k][value] -= 1;
+  int best = bruteForceScore(counts);
+
+  // groups of the tile and tiles of larger colors, the tiles of smaller colors are used
+  for (int colors = 0; colors < 16; colors += 1 << (k + 1)) {
+    bool available = std::popcount(unsigned(colors)) >= 2;
+    for (int other = k + 1; other < 4; ++other) {
+      available = available && (((colors >> other) & 1) == 0 || counts[other][value] > 0);
+    }
+    if (!available) {
+      continue;
+    }
+    for (int other = k + 1; other < 4; ++other) {
+      counts[other][value] -= (colors >> other) & 1;
+    }
+    best = std::max(best, value * (1 + std::popcount(unsigned(colors))) + bruteForceScore(counts));
+    for (int other = k + 1; other < 4; ++other) {
+      counts[other][value] += (colors >> other) & 1;
+    }
+  }
+
+  // runs of color k that start with the tile
+  int last = value;
+  int score = value;
+  while (last < 13 && counts[k][last + 1] > 0) {
+    last += 1;
+    counts[k][last] -= 1;
+    score += last;
+    if (last >= value + 2) {
+      best = std::max(best, score + bruteForceScore(counts));
+    }
+  }
+  for (; last > value; --last) {
+    counts[k][last] += 1;
+  }
+  counts[k][value] += 1;
+  return best;
+}
+
+// The best score of small racks on an empty board is the one found by trying every split into
+// sets, which checks the run transitions and group packings of the search against the rules
+static void testScoresMatchBruteForce(std::mt19937_64& rng) {
+  vector<Tile> tiles;
+  for (int copy = 0; copy < 2; ++copy) {
+    for (int k = 0; k < 4; ++k) {
+      for (int value = 1; value <= 13; ++value) {
+        tiles.push_back(Tile{value, k});
+      }
+    }
+  }
+  for (int i = 0; i < NUM_POSITIONS; ++i) {
+    // tiles of a few face values so that there are sets to find
+    const int firstValue = std::uniform_int_distribution<int>(1, 8)(rng);
+    vector<Tile> rack;
+    for (const Tile& tile : tiles) {
+      if (tile.faceValue >= firstValue && tile.faceValue < firstValue + 6) {
+        rack.push_back(tile);
+      }
+    }
+    std::shuffle(rack.begin(), rack.end(), rng);
+    rack.resize(std::uniform_int_distribution<size_t>(3, 16)(rng));
+
+    std::array<std::array<int, 15>, 4> counts{};
+    for (const Tile& tile : rack) {
+      counts[tile.color][tile.faceValue] += 1;
+    }
+    vector<TileSet> board;
+    const int score = playScore(solve(board, rack).second);
+    check(score == bruteForceScore(counts), "scoresMatchBruteForce", i);
+  }
+}
+
+// legalSets says what isLegal says of runs, groups and random sets of up to TileSet::MAX_SIZE
+// tiles, some with jokers and some with a tile changed
+static void testLegalSetsMatchIsLegal(std::mt19937_64& rng) {
+  auto uniform = [&](const int low, const int high) {
+    return std::uniform_int_distribution<int>(low, high)(rng);
+  };
+  vector<TileSet> sets;
+  for (int i = 0; i < 100 * NUM_POSITIONS; ++i) {
+    const int kind = uniform(0, 2);
+    const int size = kind == 0 ? uniform(0, TileSet::MAX_SIZE) : uniform(1, kind == 1 ? 13 : 5);
+    const int value = uniform(0, 15);
+    const int color = uniform(0, 7);
+    TileSet s;
+    for (int place = 0; place < size; ++place) {
+      Tile tile{uniform(0, 15), uniform(0, 7)};
+      if (kind == 1) {
+        tile = Tile{std::min(value + place, 15), color};
+      } else if (kind == 2) {
+        tile = Tile{value, place};
+      }
+      if (uniform(0, 9) == 0) {
+        tile = Tile{uniform(0, 15), uniform(0, 7), true};
+      } else if (uniform(0, 19) == 0) {
+        tile = Tile{uniform(0, 15), uniform(0, 7)};
+      }
+      s.tiles.push_back(tile);
+    }
+    sets.push_back(s);
+  }
+
+  const vector<uint64_t> legal = legalSets(sets);
+  check(legal.size() == (sets.size() + 63) / 64, "legalSetsSize", 0);
+  for (size_t i = 0; i < sets.size(); ++i) {
+    check(bool((legal[i / 64] >> (i % 64)) & 1) == sets[i].isLegal(), "legalSetsMatchIsLegal", i);
+  }
+}
+
+// A set of more than TileSet::MAX_SIZE tiles keeps the first ones and is not legal, and clearing
+// it makes room again
+static void testOversizedSet() {
+  vector<Tile> tiles;
+  for (int value = 1; value <= 13; ++value) {
+    tiles.push_back(Tile{value, 0});
+  }
+  tiles.insert(tiles.end(), 3, Tile{1, 0, true});
+  vector<TileSet> sets = {TileSet(tiles), TileSet({Tile{4, 0}, Tile{4, 1}, Tile{4, 2}})};
+  check(sets[0].tiles.overflowed() && sets[0].size() == TileSet::MAX_SIZE, "oversizedSet", 0);
+  check(!sets[0].isLegal() && !sets[0].isRun() && sets[1].isLegal(), "oversizedSetIsLegal", 0);
+  check(legalSets(sets)[0] == 0b10, "oversizedSetLegalSets", 0);
+
+  sets[0].tiles.clear();
+  for (int k = 0; k < 3; ++k) {
+    sets[0].tiles.push_back(Tile{4, k});
+  }
+  check(!sets[0].tiles.overflowed() && sets[0].isLegal(), "clearedOversizedSet", 0);
+}
+
+int main() {
+  std::mt19937_64 rng(1);
+  vector<Position> positions;
+  for (int i = 0; i < NUM_POSITIONS; ++i) {
+    positions.push_back(generatePosition(rng));
+  }
+
+  testTopKIsDistinct(positions);
+  testDrawValueTable(positions);
+  testEnginesAgree(positions);
+  testBoardIsKept(positions);
+  testRackEdits(positions, rng);
+  testIsValidMatchesSets(positions, rng);
+  testRecordsRoundTrip(positions);
+  testSolveStats(positions);
+  testScoringPolicy<TileCountScoring>(positions, "tileCountScoring");
+  testScoringPolicy<FaceValueScoring<0>>(positions, "faceValueScoring0");
+  testScoresMatchBruteForce(rng);
+  testRuleVariant<5, 2, 2>(rng, "ruleVariant5Colors");
+  testRuleVariant<4, 3, 4>(rng, "ruleVariant3Copies");
+  testLegalSetsMatchIsLegal(rng);
+  testOversizedSet();
+  testSelfPlay();
+  testPositionText();
+
+  if (numFailed > 0) {
+    std::printf("%d checks failed\n", numFailed);
+    return 1;
+  }
+  std::printf("all checks passed\n");
+}
@@ -0,0 +1,125 @@
+#include "ThreadPool.hxx"
+
+#include <algorithm>
+
+static uint64_t pack(const uint64_t begin, const uint64_t end) { return begin << 32 | end; }
+static uint64_t first(const uint64_t range) { return range >> 32; }
+static uint64_t last(const uint64_t range) { return range & 0xffffffff; }
+
+// the worker index of the current thread in the pool that owns it, if any
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+ThreadPool::ThreadPool(int numThreads) {
+  numThreads = std::max(1, numThreads);
+  shares = std::make_unique<Share[]>(numThreads);
+  for (int worker = 0; worker < numThreads; ++worker) {
+    threads.emplace_back([this, worker] { workerLoop(worker); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  startCondition.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+ThreadPool& ThreadPool::shared() {
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t, int)>& body) {
+  if (currentPool == this) {
+    for (size_t i = 0; i < n; ++i) {
+      body(i, currentWorker);
+    }
+    return;
+  }
+  if (n == 0) {
+    return;
+  }
+
+  std::lock_guard submitLock(submitMutex);
+  const size_t numWorkers = threads.size();
+  for (size_t worker = 0; worker < numWorkers; ++worker) {
+    shares[worker].range.store(pack(n * worker / numWorkers, n * (worker + 1) / numWorkers));
+  }
+  {
+    std::lock_guard lock(mutex);
+    this->body = &body;
+    numBusy = numWorkers;
+    epoch += 1;
+  }
+  startCondition.notify_all();
+
+  std::unique_lock lock(mutex);
+  doneCondition.wait(lock, [this] { return numBusy == 0; });
+  this->body = nullptr;
+}
+
+// take the next index from the front of our own share
+bool ThreadPool::take(int worker, size_t& i) {
+  auto& range = shares[worker].range;
+  uint64_t r = range.load();
+  while (first(r) < last(r)) {
+    if (range.compare_exchange_weak(r, pack(first(r) + 1, last(r)))) {
+      i = first(r);
+      return true;
+    }
+  }
+  return false;
+}
+
+// move half of the remaining work of some other worker into our own (empty) share
+bool ThreadPool::steal(int worker) {
+  const int numWorkers = threads.size();
+  for (int offset = 1; offset < numWorkers; ++offset) {
+    auto& range = shares[(worker + offset) % numWorkers].range;
+    uint64_t r = range.load();
+    while (first(r) < last(r)) {
+      const uint64_t middle = last(r) - (last(r) - first(r) + 1) / 2;
+      if (range.compare_exchange_weak(r, pack(first(r), middle))) {
+        shares[worker].range.store(pack(middle, last(r)));
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::workerLoop(int worker) {
+  currentPool = this;
+  currentWorker = worker;
+  uint64_t seen = 0;
+  while (true) {
+    const std::function<void(size_t, int)>* work;
+    {
+      std::unique_lock lock(mutex);
+      startCondition.wait(lock, [&] { return stopping || epoch != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = epoch;
+      work = body;
+    }
+
+    size_t i;
+    do {
+      while (take(worker, i)) {
+        (*work)(i, worker);
+      }
+    } while (steal(worker));
+
+    std::lock_guard lock(mutex);
+    numBusy -= 1;
+    if (numBusy == 0) {
+      doneCondition.notify_one();
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that split index ranges between them.
+// Each worker starts with an equal share of the range. When a worker runs out it steals half of
+// what is left in the share of another worker, so uneven work still keeps every core busy.
+class ThreadPool {
+public:
+  explicit ThreadPool(int numThreads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int size() const { return threads.size(); }
+
+  // Calls body(i, worker) for every i in [0, n) and returns when all calls are done.
+  // worker is in [0, size()) and no two calls with the same worker run at the same time.
+  // A call from inside a body runs serially on the calling worker.
+  void parallelFor(size_t n, const std::function<void(size_t, int)>& body);
+
+  // the pool used by the library when the caller does not supply one
+  static ThreadPool& shared();
+
+private:
+  // [begin, end) packed as begin << 32 | end so that a share is updated with a single CAS
+  struct alignas(64) Share {
+    std::atomic<uint64_t> range{0};
+  };
+
+  void workerLoop(int worker);
+  bool take(int worker, size_t& i);
+  bool steal(int worker);
+
+  std::vector<std::thread> threads;
+  std::unique_ptr<Share[]> shares;
+
+  std::mutex submitMutex; // one parallelFor at a time
+  std::mutex mutex;
+  std::condition_variable startCondition;
+  std::condition_variable doneCondition;
+  const std::function<void(size_t, int)>* body = nullptr;
+  uint64_t epoch = 0;
+  int numBusy = 0;
+  bool stopping = false;
+};
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <cstdint>
+
+// A tile packed into a byte, face values go up to 15 and colors up to 7. A joker keeps the face
+// value and color that it stands for, if it has been placed. The fields are small unsigned
+// integers, cast them to int before printing them with a stream.
 struct Tile {
-  int faceValue = 0;
-  int color = 0;
-  bool isJoker = false;
+  uint8_t faceValue : 4 = 0;
+  uint8_t color : 3 = 0;
+  bool isJoker : 1 = false;
 
   Tile() = default;
 
-  Tile(int faceValue, int color, bool isJoker = false)
+  constexpr Tile(int faceValue, int color, bool isJoker = false)
       : faceValue(faceValue), color(color), isJoker(isJoker) {}
-};
\ No newline at end of file
+};
+static_assert(sizeof(Tile) == 1);
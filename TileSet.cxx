@@ -1,11 +1,15 @@
 #include "TileSet.hxx"
+#include <array>
+#include <bit>
 #include <bitset>
+#include <cstdint>
+#include <cstring>
 
 bool TileSet::isGroup() const {
-  if (tiles.size() < 3 || tiles.size() > 4) {
+  if (tiles.size() < 3 || tiles.size() > 4 || tiles.overflowed()) {
     return false;
   }
-  std::bitset<4> colorBits;
+  std::bitset<8> colorBits;
   Tile startTile = tiles[0];
   int numWildCardsInSet = 0;
   for (auto tile : tiles) {
@@ -25,161 +29,151 @@ bool TileSet::isGroup() const {
 }
 
 bool TileSet::isRun() const {
-  if (tiles.size() < 3 || tiles.size() > 13) {
+  if (tiles.size() < 3 || tiles.size() > MAX_FACE_VALUE || tiles.overflowed()) {
     return false;
   }
-  Tile startTile = tiles[0];
-  for (auto tile : tiles) {
-    if (startTile.isJoker) {
-      startTile = tile;
+  // the face value and color that the current tile must have, once a tile that is not a joker
+  // has been seen
+  int faceValue = 0;
+  int color = -1;
+  for (int i = 0; auto tile : tiles) {
+    if (!tile.isJoker && color == -1) {
+      faceValue = tile.faceValue - i;
+      color = tile.color;
     }
-    if (!tile.isJoker) {
-      if (tile.color != startTile.color || tile.faceValue != startTile.faceValue) {
-        return false;
-      }
+    if (!tile.isJoker && (tile.color != color || tile.faceValue != faceValue + i)) {
+      return false;
     }
-    startTile.faceValue += 1;
+    i += 1;
   }
   return true;
 }
 
 bool TileSet::isLegal() const {
-  if (size() < 3 || size() > 13) {
+  if (size() < 3 || size() > MAX_FACE_VALUE || tiles.overflowed()) {
     return false;
   }
   return isGroup() || isRun();
 }
 
-#include <bitset>
-// TODO this sucks
+// Orders the tiles of a run by face value and gives the jokers the face value and color that they
+// stand for. The jokers fill the gaps after the first tile that is not a joker, then extend the
+// run upwards, and then downwards. A run of three with two jokers is left as it is, as is a set
+// that does not become a run.
 void TileSet::sortRun() {
-  // Does nothing if the set is not a run
-  std::bitset<13> bits;
+  // bit v is set if a tile of face value v is in the set
+  uint32_t values = 0;
+  int color = -1;
   int numJokers = 0;
-  int joker1Index = -1;
-  int joker2Index = -1;
-  int color = 0;
-  for (int i = 0; auto& t : tiles) {
-    if (!t.isJoker) {
-      bits.set(t.faceValue - 1);
-      color = t.color;
-    } else {
+  for (const Tile& t : tiles) {
+    if (t.isJoker) {
       numJokers += 1;
-      if (joker1Index == -1) {
-        joker1Index = i;
-      } else {
-        joker2Index = i;
-      }
+      continue;
     }
-    i += 1;
+    if ((color != -1 && t.color != color) || ((values >> t.faceValue) & 1)) {
+      return;
+    }
+    color = t.color;
+    values |= uint32_t(1) << t.faceValue;
   }
-  if (tiles.size() == 3 && numJokers == 0) {
-    std::sort(tiles.begin(), tiles.end(),
-              [](Tile& l, Tile& r) { return l.faceValue <= r.faceValue && l.color <= r.color; });
+  if (color == -1 || (tiles.size() == 3 && numJokers == 2)) {
     return;
   }
-  if (tiles.size() == 3 && numJokers == 2) {
+
+  uint32_t jokers = 0;
+  const int first = std::countr_zero(values);
+  for (int v = first + 1; v <= MAX_FACE_VALUE && numJokers > 0; ++v) {
+    if (!((values >> v) & 1)) {
+      jokers |= uint32_t(1) << v;
+      numJokers -= 1;
+    }
+  }
+  for (int v = first - 1; v >= 1 && numJokers > 0; --v) {
+    jokers |= uint32_t(1) << v;
+    numJokers -= 1;
+  }
+  // the tiles must cover consecutive face values
+  const uint32_t all = values | jokers;
+  if (numJokers > 0 || ((all >> std::countr_zero(all)) & ((all >> std::countr_zero(all)) + 1))) {
     return;
   }
-  if (numJokers > 0) {
-    // Distribute as many jokers as possible after the tile with smallest face value
-    const int8_t first = bits._Find_first();
-    for (int8_t i = first + 1; i < 13 && numJokers; ++i) {
-      if (!bits.test(i)) { // put joker here
-        if (joker1Index != -1) {
-          tiles[joker1Index].faceValue = i + 1;
-          tiles[joker1Index].color = color;
-          joker1Index = -1;
-        } else if (joker2Index != -1) {
-          tiles[joker2Index].faceValue = i + 1;
-          tiles[joker2Index].color = color;
-          joker2Index = -1;
-        }
-        numJokers -= 1;
-      }
+
+  Tiles sorted;
+  for (int v = 1; v <= MAX_FACE_VALUE; ++v) {
+    if ((all >> v) & 1) {
+      sorted.push_back(Tile{v, color, bool((jokers >> v) & 1)});
     }
-    // Place any remaining jokers before all other tiles
-    for (int8_t i = first - 1; i >= 1 && numJokers; --i) {
-      if (!bits.test(i)) { // put joker here
-        if (joker1Index != -1) {
-          tiles[joker1Index].faceValue = i + 1;
-          tiles[joker1Index].color = color;
-          joker1Index = -1;
-        } else if (joker2Index != -1) {
-          tiles[joker2Index].faceValue = i + 1;
-          tiles[joker2Index].color = color;
-          joker2Index = -1;
-        }
-        numJokers -= 1;
-      }
+  }
+  tiles = sorted;
+}
+
+// legalSets reads the tiles of a set as two words of bytes and checks all the tiles at once
+static_assert(std::bit_cast<uint8_t>(Tile{5, 3, true}) == 0xb5,
+              "a tile byte holds the face value in bits 0-3, the color in bits 4-6 and the joker "
+              "flag in bit 7");
+static const uint64_t ONES = 0x0101010101010101;
+// the place of each tile in the two words
+static const std::array<uint64_t, 2> PLACES = {0x0706050403020100, 0x0f0e0d0c0b0a0908};
+
+// a byte of ones for each of the first size tiles, in the two words
+static constexpr std::array<std::array<uint64_t, 2>, TileSet::MAX_SIZE + 1> LIVE_TILES = [] {
+  std::array<std::array<uint64_t, 2>, TileSet::MAX_SIZE + 1> live{};
+  for (int size = 0; size <= TileSet::MAX_SIZE; ++size) {
+    for (int i = 0; i < size; ++i) {
+      live[size][i / 8] |= uint64_t(0xff) << (i % 8 * 8);
     }
   }
-    std::sort(tiles.begin(), tiles.end(),
-              [](Tile& l, Tile& r) { return l.faceValue <= r.faceValue && l.color <= r.color; });
+  return live;
+}();
 
-  // std::vector<Tile> jokers;
-  // for (auto& t : tiles) { // get all jokers
-  //   if (t.isJoker)
-  //     jokers.push_back(t);
-  // }
-  // for (int i = 0; i < jokers.size(); ++i) { // remove them from the vector
-  //   for (auto it = tiles.begin(); it != tiles.end(); ++it) {
-  //     if (it->isJoker) {
-  //       tiles.erase(it);
-  //       break;
-  //     };
-  //   }
-  // }
-  // int numJokers = jokers.size();
-  // for (int j = 0; j < jokers.size(); ++j) {
-  //   for (int i = 0; i < tiles.size() - 1; ++i) {
-  //     if (tiles[i].faceValue + 1 != tiles[i + 1].faceValue) {
-  //       Tile joker = jokers[j];
-  //       joker.color = tiles[i].color;
-  //       joker.faceValue = tiles[i].faceValue + 1;
-  //       numJokers -=1;
-  //       tiles.insert(tiles.begin() + i + 1, joker);
-  //       break;
-  //     }
-  //   }
-  // }
-  // if (numJokers > 0) {
-  //   for (int i = 0; i < numJokers; ++i) {
-  //   }
-  // }
+// isLegal without branches on the tiles, which are usually too random to predict
+static bool isLegalPacked(const TileSet& s) {
+  const int size = s.tiles.size();
+  // tiles 0-7 and tiles 8-14, the second word is read from tile 7 so that it stays in the set
+  std::array<uint64_t, 2> words;
+  std::memcpy(&words[0], s.tiles.begin(), 8);
+  std::memcpy(&words[1], s.tiles.begin() + 7, 8);
+  words[1] >>= 8;
 
-  // if (tiles.size() <= 1) {
-  //   return;
-  // }
-  // int numJokers = 0;
-  // for (auto& t : tiles) {
-  //   numJokers += int(t.isJoker);
-  // }
-  // if (numJokers == 2 && tiles.size() <= 3) {
-  //   return;
-  // }
-  // std::sort(tiles.begin(), tiles.end(),
-  //           [](Tile l, Tile r) { return l.faceValue <= r.faceValue && !l.isJoker; });
-  // if (numJokers == 0) {
-  //   return;
-  // }
-  // // Sort then if there are holes, fill them with jokers
-  // const int numNonJokers = tiles.size() - numJokers;
-  // for (int i = 0, j = 0; i < numNonJokers - 1; ++i) {
-  //   if (tiles[i].faceValue - tiles[i + 1].faceValue == 2 && numJokers >= 1) {
-  //     tiles[numNonJokers + j].faceValue = tiles[i].faceValue + 1;
-  //     tiles[numNonJokers + j].color = tiles[i].color;
-  //     j += 1;
-  //   }
-  //   else if (tiles[i].faceValue - tiles[i + 1].faceValue == 3 && numJokers == 2) {
-  //     tiles[numNonJokers + j].faceValue = tiles[i].faceValue + 1;
-  //     tiles[numNonJokers + j].color = tiles[i].color;
-  //     j += 1;
-  //     tiles[numNonJokers + j].faceValue = tiles[i].faceValue + 2;
-  //     tiles[numNonJokers + j].color = tiles[i].color;
-  //     j += 1;
-  //   }
-  // }
-  // std::sort(tiles.begin(), tiles.end(), [](Tile l, Tile r) { return l.faceValue <= r.faceValue;
-  // });
+  // per word: a byte of ones for each tile that is not a joker, and for each tile the face value,
+  // and the face value - place and the color, which are the same for all the tiles of a run
+  std::array<uint64_t, 2> tiles;
+  std::array<uint64_t, 2> faces;
+  std::array<uint64_t, 2> runKeys;
+  for (int h = 0; h < 2; ++h) {
+    const uint64_t jokers = words[h] >> 7 & ONES;
+    tiles[h] = LIVE_TILES[size][h] & ~(jokers * 0xff);
+    faces[h] = words[h] & 0x0f * ONES;
+    runKeys[h] = (faces[h] + 0x10 * ONES - PLACES[h]) | (words[h] & 0x70 * ONES) << 1;
+  }
+
+  // the byte of the first tile that is not a joker, spread over a word
+  const bool firstInWord0 = tiles[0] != 0;
+  const int shift = std::countr_zero(firstInWord0 ? tiles[0] : tiles[1]) % 64;
+  const uint64_t firstFace = ((firstInWord0 ? faces[0] : faces[1]) >> shift & 0xff) * ONES;
+  const uint64_t firstRunKey = ((firstInWord0 ? runKeys[0] : runKeys[1]) >> shift & 0xff) * ONES;
+
+  // the conditions are combined with & so that they do not branch either
+  const bool run = (size >= 3) & (size <= TileSet::MAX_FACE_VALUE) &
+                   (((runKeys[0] ^ firstRunKey) & tiles[0]) == 0) &
+                   (((runKeys[1] ^ firstRunKey) & tiles[1]) == 0);
+  // a group has at most four tiles, all in the first word
+  unsigned colors = 0;
+  unsigned repeatedColors = 0;
+  for (int i = 0; i < 4; ++i) {
+    const unsigned color = unsigned(tiles[0] >> (8 * i) & 1) << (words[0] >> (8 * i + 4) & 7);
+    repeatedColors |= colors & color;
+    colors |= color;
+  }
+  const bool group = (size >= 3) & (size <= 4) & (((faces[0] ^ firstFace) & tiles[0]) == 0) &
+                     (repeatedColors == 0);
+  return (run | group) & !s.tiles.overflowed();
+}
+
+std::vector<uint64_t> legalSets(std::span<const TileSet> sets) {
+  std::vector<uint64_t> legal((sets.size() + 63) / 64);
+  for (size_t i = 0; i < sets.size(); ++i) {
+    legal[i / 64] |= uint64_t(isLegalPacked(sets[i])) << (i % 64);
+  }
+  return legal;
 }
@@ -1,15 +1,72 @@
 #pragma once
 
 #include "Tile.hxx"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <vector>
 
 struct TileSet {
-  std::vector<Tile> tiles;
+  // the face values of the standard game, the longest legal run
+  static constexpr int MAX_FACE_VALUE = 13;
+  // the longest run of the largest face value that a Tile can hold
+  static constexpr int MAX_SIZE = 15;
+
+  // The tiles of a set, stored inline so that sets never allocate. Holds at most MAX_SIZE tiles,
+  // the tiles pushed after that are dropped and mark the tiles as overflowed.
+  class Tiles {
+  public:
+    Tiles() = default;
+    template <typename It> Tiles(It first, It last) {
+      for (; first != last; ++first) {
+        push_back(*first);
+      }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Tile* begin() { return data.data(); }
+    Tile* end() { return data.data() + count; }
+    const Tile* begin() const { return data.data(); }
+    const Tile* end() const { return data.data() + count; }
+    Tile& operator[](size_t i) { return data[i]; }
+    const Tile& operator[](size_t i) const { return data[i]; }
+    Tile& back() { return data[count - 1]; }
+    const Tile& back() const { return data[count - 1]; }
+
+    bool overflowed() const { return overflow; }
+
+    void push_back(Tile tile) {
+      if (count < MAX_SIZE) {
+        data[count++] = tile;
+      } else {
+        overflow = true;
+      }
+    }
+    void clear() {
+      count = 0;
+      overflow = false;
+    }
+
+  private:
+    std::array<Tile, MAX_SIZE> data{};
+    // in one byte so that the tiles fit in 16 bytes
+    uint8_t count : 7 = 0;
+    bool overflow : 1 = false;
+  };
+
+  Tiles tiles;
   TileSet() = default;
-  TileSet(const std::vector<Tile>& tiles) : tiles(tiles) {}
+  // more than MAX_SIZE tiles give an overflowed set, which is never legal
+  TileSet(const std::vector<Tile>& tiles) : tiles(tiles.begin(), tiles.end()) {}
   int size() const { return tiles.size(); }
   bool isRun() const;
   bool isGroup() const;
   bool isLegal() const;
   void sortRun();
-};
\ No newline at end of file
+};
+
+// Whether each set is legal, as isLegal() would say, checked on the tile bytes of the set as words
+// and without branches. Bit i % 64 of word i / 64 is set if sets[i] is legal.
+std::vector<uint64_t> legalSets(std::span<const TileSet> sets);